@@ -0,0 +1,237 @@
+/* Copyright 2010 by Yasuhiro Matsumoto
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * codec
+ *
+ * percent, base64 and hex encoders driven by lookup tables. the caller
+ * sizes dst up front, so encoding a string is a single pass without
+ * allocations. with SSE2, runs of 16 unreserved letters, which is most of
+ * a status text or a signature base string, are checked and copied in one
+ * go, and hex digits are made 16 bytes at a time.
+ *
+ * the oauth nonce is made here too, so it can be timed without the gui.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sha1.h"
+#include "codec.h"
+
+#ifdef _WIN32
+# ifndef snprintf
+#  define snprintf _snprintf
+# endif
+# ifndef random
+#  define random() rand()
+# endif
+#endif
+
+#if defined(__GNUC__) && defined(__SSE2__) && !defined(CODEC_NO_SIMD)
+# define CODEC_SSE2
+# include <emmintrin.h>
+#endif
+
+static const char codec_hex_upper[] = "0123456789ABCDEF";
+static const char codec_hex_lower[] = "0123456789abcdef";
+
+static const char codec_base64[] =
+"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+"abcdefghijklmnopqrstuvwxyz"
+"0123456789+/";
+
+/* 1 for ALPHA, DIGIT and "-._~" */
+static const unsigned char codec_unreserved[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,
+  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+#ifdef CODEC_SSE2
+/* bytes in lo..hi, as signed bytes, so anything >= 0x80 is out */
+#define CODEC_RANGE(v,lo,hi) \
+  _mm_and_si128(_mm_cmpgt_epi8((v), _mm_set1_epi8((lo) - 1)), \
+                _mm_cmpgt_epi8(_mm_set1_epi8((hi) + 1), (v)))
+
+/* bit i set when byte i of the 16 at src is unreserved */
+static inline int
+codec_unreserved_sse2(const char* src) {
+  __m128i v = _mm_loadu_si128((const __m128i*) src);
+  __m128i r = _mm_or_si128(
+          _mm_or_si128(CODEC_RANGE(v, 'a', 'z'), CODEC_RANGE(v, 'A', 'Z')),
+          _mm_or_si128(CODEC_RANGE(v, '0', '9'), CODEC_RANGE(v, '-', '.')));
+  r = _mm_or_si128(r, _mm_or_si128(
+          _mm_cmpeq_epi8(v, _mm_set1_epi8('_')),
+          _mm_cmpeq_epi8(v, _mm_set1_epi8('~'))));
+  return _mm_movemask_epi8(r);
+}
+
+/* nibbles 0..15 to '0'..'9', 'a'..'f' */
+static inline __m128i
+codec_hex_sse2(__m128i n) {
+  __m128i letter = _mm_cmpgt_epi8(n, _mm_set1_epi8(9));
+  n = _mm_add_epi8(n, _mm_set1_epi8('0'));
+  return _mm_add_epi8(n, _mm_and_si128(letter, _mm_set1_epi8('a' - '0' - 10)));
+}
+#endif
+
+size_t
+urlencode_size(const char* src, size_t size) {
+  size_t len = size;
+#ifdef CODEC_SSE2
+  for (; size >= 16; src += 16, size -= 16)
+    len += 2 * (16 - __builtin_popcount(codec_unreserved_sse2(src)));
+#endif
+  for (; size; src++, size--)
+    if (!codec_unreserved[(unsigned char) *src]) len += 2;
+  return len;
+}
+
+char*
+urlencode(char* dst, const char* src, size_t size) {
+#ifdef CODEC_SSE2
+  for (; size >= 16; src += 16, size -= 16) {
+    int mask = codec_unreserved_sse2(src);
+    int n;
+    if (mask == 0xFFFF) {
+      memcpy(dst, src, 16);
+      dst += 16;
+      continue;
+    }
+    for (n = 0; n < 16; n++) {
+      unsigned char c = (unsigned char) src[n];
+      if (mask & (1 << n))
+        *dst++ = c;
+      else {
+        *dst++ = '%';
+        *dst++ = codec_hex_upper[c >> 4];
+        *dst++ = codec_hex_upper[c & 0x0F];
+      }
+    }
+  }
+#endif
+  for (; size; src++, size--) {
+    unsigned char c = (unsigned char) *src;
+    if (codec_unreserved[c])
+      *dst++ = c;
+    else {
+      *dst++ = '%';
+      *dst++ = codec_hex_upper[c >> 4];
+      *dst++ = codec_hex_upper[c & 0x0F];
+    }
+  }
+  *dst = 0;
+  return dst;
+}
+
+char*
+urlencode_alloc(const char* src) {
+  size_t size = strlen(src);
+  char* ret = (char*) malloc(urlencode_size(src, size) + 1);
+  if (ret) urlencode(ret, src, size);
+  return ret;
+}
+
+char*
+base64encode(char* dst, const unsigned char* src, size_t size) {
+  unsigned long n;
+
+  for (; size >= 3; src += 3, size -= 3) {
+    n = ((unsigned long) src[0] << 16) | ((unsigned long) src[1] << 8) | src[2];
+    *dst++ = codec_base64[(n >> 18) & 0x3F];
+    *dst++ = codec_base64[(n >> 12) & 0x3F];
+    *dst++ = codec_base64[(n >>  6) & 0x3F];
+    *dst++ = codec_base64[ n        & 0x3F];
+  }
+  if (size) {
+    n = (unsigned long) src[0] << 16;
+    if (size == 2) n |= (unsigned long) src[1] << 8;
+    *dst++ = codec_base64[(n >> 18) & 0x3F];
+    *dst++ = codec_base64[(n >> 12) & 0x3F];
+    *dst++ = size == 2 ? codec_base64[(n >> 6) & 0x3F] : '=';
+    *dst++ = '=';
+  }
+  *dst = 0;
+  return dst;
+}
+
+char*
+base64encode_alloc(const unsigned char* src, size_t size) {
+  char* ret = (char*) malloc(BASE64_SIZE(size) + 1);
+  if (ret) base64encode(ret, src, size);
+  return ret;
+}
+
+char*
+to_hex(char* dst, const unsigned char* src, size_t size) {
+#ifdef CODEC_SSE2
+  for (; size >= 16; src += 16, size -= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*) src);
+    __m128i lo = _mm_and_si128(v, _mm_set1_epi8(0x0F));
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+    hi = codec_hex_sse2(hi);
+    lo = codec_hex_sse2(lo);
+    _mm_storeu_si128((__m128i*) dst, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*) (dst + 16), _mm_unpackhi_epi8(hi, lo));
+    dst += 32;
+  }
+#endif
+  for (; size; src++, size--) {
+    *dst++ = codec_hex_lower[*src >> 4];
+    *dst++ = codec_hex_lower[*src & 0x0F];
+  }
+  *dst = 0;
+  return dst;
+}
+
+char*
+to_hex_alloc(const unsigned char* src, size_t size) {
+  char* ret = (char*) malloc(HEX_SIZE(size) + 1);
+  if (ret) to_hex(ret, src, size);
+  return ret;
+}
+
+char*
+get_nonce_alloc() {
+  char buf[64] = {0};
+  unsigned char digest[20];
+  snprintf(buf, sizeof(buf), "%d %d", (int) time(0), (int) random());
+  sha1((const unsigned char*) buf, strlen(buf), digest);
+  return to_hex_alloc(digest, sizeof(digest));
+}
+
+/* vim:set et sw=4: */
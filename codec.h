@@ -0,0 +1,59 @@
+/* Copyright 2010 by Yasuhiro Matsumoto
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef gtktweeter_codec_h
+#define gtktweeter_codec_h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+
+/* the encoders write into dst, which has room for the encoded size and a
+   NUL, and return the NUL at the end. the _alloc ones return malloc'ed
+   strings and NULL when out of memory. */
+
+/* percent encoding of all but the RFC 3986 unreserved letters, as OAuth
+   wants it: upper case hex digits and no '+' for spaces */
+size_t  urlencode_size    (const char* src, size_t size);
+char *  urlencode         (char* dst, const char* src, size_t size);
+char *  urlencode_alloc   (const char* src);
+
+#define BASE64_SIZE(size)  ((((size) + 2) / 3) * 4)
+char *  base64encode      (char* dst, const unsigned char* src, size_t size);
+char *  base64encode_alloc(const unsigned char* src, size_t size);
+
+/* lower case, two letters per byte */
+#define HEX_SIZE(size)     ((size) * 2)
+char *  to_hex            (char* dst, const unsigned char* src, size_t size);
+char *  to_hex_alloc      (const unsigned char* src, size_t size);
+
+/* oauth_nonce, hex of the sha1 of the time and random() */
+char *  get_nonce_alloc   (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
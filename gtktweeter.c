@@ -26,8 +26,11 @@
 #include <glib/gconvert.h>
 #include <glib/gstdio.h>
 #include <parson.h>
+#include "sha1.h"
+#include "codec.h"
 #include <ctype.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <time.h>
 #include <string.h>
 #include <curl/curl.h>
@@ -64,38 +67,60 @@
 #define APP_TITLE                  "GtkTweeter"
 #define APP_NAME                   "gtktweeter"
 #define APP_VERSION                "0.1.0"
-#define SERVICE_SEARCH_STATUS_URL  "https://api.twitter.com/1.1/search/tweets.json"
-#define SERVICE_RATE_LIMIT_URL     "https://api.twitter.com/1.1/application/rate_limit_status.json"
-#define SERVICE_USER_SHOW_URL      "https://api.twitter.com/1.1/users/show/%s.json"
-#define SERVICE_UPDATE_URL         "https://api.twitter.com/1.1/statuses/update.json"
-#define SERVICE_RETWEET_URL        "https://api.twitter.com/1.1/statuses/retweet/%s.json"
-#define SERVICE_FAVORITE_URL       "https://api.twitter.com/1.1/favorites/create/%s.json"
-#define SERVICE_UNFAVORITE_URL     "https://api.twitter.com/1.1/favorites/destroy/%s.json"
-#define SERVICE_REPLIES_STATUS_URL "https://api.twitter.com/1.1/statuses/mentions.json"
-#define SERVICE_HOME_STATUS_URL    "https://api.twitter.com/1.1/statuses/home_timeline.json"
-#define SERVICE_USER_STATUS_URL    "https://api.twitter.com/1.1/statuses/user_timeline/%s.json"
-#define SERVICE_THREAD_STATUS_URL  "https://api.twitter.com/1.1/statuses/thread_timeline/%s.json"
-#define SERVICE_ACCESS_TOKEN_URL   "https://api.twitter.com/oauth/access_token"
+#define SERVICE_API_URL            "https://api.twitter.com"
+/* API paths below are relative to api_url, see get_api_url_alloc */
+#define SERVICE_SEARCH_STATUS_URL  "/1.1/search/tweets.json"
+#define SERVICE_USER_SHOW_URL      "/1.1/users/show/%s.json"
+#define SERVICE_USERS_LOOKUP_URL   "/1.1/users/lookup.json"
+#define SERVICE_UPDATE_URL         "/1.1/statuses/update.json"
+#define SERVICE_RETWEET_URL        "/1.1/statuses/retweet/%s.json"
+#define SERVICE_FAVORITE_URL       "/1.1/favorites/create/%s.json"
+#define SERVICE_UNFAVORITE_URL     "/1.1/favorites/destroy/%s.json"
+#define SERVICE_REPLIES_STATUS_URL "/1.1/statuses/mentions.json"
+#define SERVICE_HOME_STATUS_URL    "/1.1/statuses/home_timeline.json"
+#define SERVICE_USER_STATUS_URL    "/1.1/statuses/user_timeline/%s.json"
+#define SERVICE_THREAD_STATUS_URL  "/1.1/statuses/thread_timeline/%s.json"
+#define SERVICE_ACCESS_TOKEN_URL   "/oauth/access_token"
+#define SERVICE_REQUEST_TOKEN_URL  "/oauth/request_token"
 #define SERVICE_STATUS_URL         "http://twitter.com/%s/status/%s"
 #define SERVICE_AUTH_URL           "https://twitter.com/oauth/authorize"
-#define SERVICE_REQUEST_TOKEN_URL  "http://api.twitter.com/oauth/request_token"
+#define SERVICE_STREAM_URL         "https://userstream.twitter.com/1.1/user.json"
 #define ACCEPT_LETTER_URL          "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789;/?:@&=+$,-_.!~*'%"
 #define ACCEPT_LETTER_USER         "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_"
 #define ACCEPT_LETTER_TAG          "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_"
 #define ACCEPT_LETTER_REPLY        "1234567890"
 #define TOOLTIP_TIMER_SPAN         (1500)
 #define RELOAD_TIMER_SPAN          (60*1000)
+#define POLL_COUNT                 (20)
+#define POLL_COUNT_MAX             (200)
+#define PAGE_COUNT                 (50)
+#define TIMELINE_BACKFILL_MAX      (4)
+#define USER_LOOKUP_MAX            (100)
+#define PROFILE_CACHE_TTL          (15*60)
+#define STREAM_STALL_TIME          (90)
+#define STREAM_BACKOFF_NETWORK     (250)
+#define STREAM_BACKOFF_HTTP        (5*1000)
+#define STREAM_BACKOFF_LIMITED     (60*1000)
+#define STREAM_BACKOFF_MAX         (320*1000)
 #define REQUEST_TIMEOUT            (10)
+#define CONNECTION_IDLE_TIME       (120)
+#define CONNECTION_CACHE_SIZE      (8)
+#define MEMFILE_MIN_SIZE           (4096)
+#define MEMFILE_MAX_RESERVE        (16*1024*1024)
+#define HTTP_STATS_SAMPLES         (64)
+#define HTTP_REPLAY_TICK           (50)
+#define RATE_LIMIT_RESERVE         (5)
+#define HTTP_MAX_TRANSFERS         (6)
+#define HTTP_MAX_BACKGROUND        (4)
+#define HTTP_CONDITION_FILE        "conditions"
+#define SHORT_URL_FILE             "short_urls"
+#define SHORT_URL_CACHE_TTL        (30*24*60*60)
+#define SHORT_URL_MAX_REDIRECTS    (10)
 #define SHORTURL_API_URL           "http://is.gd/api.php?longurl=%s"
 
-typedef struct _PIXBUF_CACHE {
-  const char* user_id;
-  GdkPixbuf* pixbuf;
-} PIXBUF_CACHE;
-
 typedef struct _PROCESS_THREAD_INFO {
   GThreadFunc func;
-  gboolean processing;
+  GMainLoop* loop;
   gpointer data;
   gpointer retval;
 } PROCESS_THREAD_INFO;
@@ -106,1028 +131,2000 @@ typedef struct _APPLICATION_INFO {
   char* access_token;
   char* access_token_secret;
   char* font;
+  int idle_time;
+  char* log_file;
+  char* api_url;
+  char* record_dir;
+  char* replay_dir;
+  int replay_latency;
+  int replay_bandwidth;
+  int streaming;
+  char* stream_url;
 } APPLICATION_INFO;
 
 static GdkCursor* hand_cursor = NULL;
 static GdkCursor* regular_cursor = NULL;
 static GdkCursor* watch_cursor = NULL;
-static char* last_condition = NULL;
 static int is_processing = FALSE;
+static int is_posting = FALSE;
 static guint reload_timer = 0;
 static guint tooltip_timer = 0;
 static APPLICATION_INFO application_info = {0};
 
 static void update_timeline(GtkWidget*, gpointer);
+static void search_timeline(GtkWidget*, gpointer);
 static void start_reload_timer(GtkWidget* window);
 static void stop_reload_timer(GtkWidget* window);
 static void reset_reload_timer(GtkWidget* window);
+static void timeline_backfill(GtkWidget* window);
+static gboolean timeline_stream_skip_poll(GtkWidget* window);
+static void hover_stop(GtkWidget* window);
 
 static gboolean setup_dialog(GtkWidget* window);
+static char* get_http_header_alloc(const char* ptr, const char* key);
 static int load_config();
 static int save_config();
 static gpointer process_thread(gpointer data);
 
-/**
- * sha1/hmac
- */
 typedef struct {
-  unsigned long int total[2];
-  unsigned long int state[5];
-  unsigned char buffer[64];
-} sha1_context;
-
-#define GET_UINT32(n,b,i) {                         \
-  (n) = ( (unsigned long int) (b)[(i)    ] << 24 )  \
-      | ( (unsigned long int) (b)[(i) + 1] << 16 )  \
-      | ( (unsigned long int) (b)[(i) + 2] <<  8 )  \
-      | ( (unsigned long int) (b)[(i) + 3]       ); \
-}
-
-#define PUT_UINT32(n,b,i) {                     \
-  (b)[(i)    ] = (unsigned char) ( (n) >> 24 ); \
-  (b)[(i) + 1] = (unsigned char) ( (n) >> 16 ); \
-  (b)[(i) + 2] = (unsigned char) ( (n) >>  8 ); \
-  (b)[(i) + 3] = (unsigned char) ( (n)       ); \
-}
-
-static void
-sha1_starts(sha1_context* ctx) {
-  ctx->total[0] = 0;
-  ctx->total[1] = 0;
-
-  ctx->state[0] = 0x67452301;
-  ctx->state[1] = 0xEFCDAB89;
-  ctx->state[2] = 0x98BADCFE;
-  ctx->state[3] = 0x10325476;
-  ctx->state[4] = 0xC3D2E1F0;
-}
-
-static void
-sha1_process(sha1_context* ctx, const unsigned char data[64]) {
-  unsigned long int temp, W[16], A, B, C, D, E;
-
-  GET_UINT32( W[0],  data,  0 );
-  GET_UINT32( W[1],  data,  4 );
-  GET_UINT32( W[2],  data,  8 );
-  GET_UINT32( W[3],  data, 12 );
-  GET_UINT32( W[4],  data, 16 );
-  GET_UINT32( W[5],  data, 20 );
-  GET_UINT32( W[6],  data, 24 );
-  GET_UINT32( W[7],  data, 28 );
-  GET_UINT32( W[8],  data, 32 );
-  GET_UINT32( W[9],  data, 36 );
-  GET_UINT32( W[10], data, 40 );
-  GET_UINT32( W[11], data, 44 );
-  GET_UINT32( W[12], data, 48 );
-  GET_UINT32( W[13], data, 52 );
-  GET_UINT32( W[14], data, 56 );
-  GET_UINT32( W[15], data, 60 );
-
-#define S(x,n) ((x << n) | ((x & 0xFFFFFFFF) >> (32 - n)))
-
-#define R(t) \
-  (          \
-    temp = W[(t -  3) & 0x0F] ^ W[(t - 8) & 0x0F] ^     \
-    W[(t - 14) & 0x0F] ^ W[ t      & 0x0F],             \
-    ( W[t & 0x0F] = S(temp,1) )                         \
-  )
-
-#define P(a,b,c,d,e,x)                                  \
-  {                                                     \
-    e += S(a,5) + F(b,c,d) + K + x; b = S(b,30);        \
-  }
-
-  A = ctx->state[0];
-  B = ctx->state[1];
-  C = ctx->state[2];
-  D = ctx->state[3];
-  E = ctx->state[4];
-
-#define F(x,y,z) (z ^ (x & (y ^ z)))
-#define K 0x5A827999
-
-  P( A, B, C, D, E, W[0]  );
-  P( E, A, B, C, D, W[1]  );
-  P( D, E, A, B, C, W[2]  );
-  P( C, D, E, A, B, W[3]  );
-  P( B, C, D, E, A, W[4]  );
-  P( A, B, C, D, E, W[5]  );
-  P( E, A, B, C, D, W[6]  );
-  P( D, E, A, B, C, W[7]  );
-  P( C, D, E, A, B, W[8]  );
-  P( B, C, D, E, A, W[9]  );
-  P( A, B, C, D, E, W[10] );
-  P( E, A, B, C, D, W[11] );
-  P( D, E, A, B, C, W[12] );
-  P( C, D, E, A, B, W[13] );
-  P( B, C, D, E, A, W[14] );
-  P( A, B, C, D, E, W[15] );
-  P( E, A, B, C, D, R(16) );
-  P( D, E, A, B, C, R(17) );
-  P( C, D, E, A, B, R(18) );
-  P( B, C, D, E, A, R(19) );
-
-#undef K
-#undef F
-
-#define F(x,y,z) (x ^ y ^ z)
-#define K 0x6ED9EBA1
-
-  P( A, B, C, D, E, R(20) );
-  P( E, A, B, C, D, R(21) );
-  P( D, E, A, B, C, R(22) );
-  P( C, D, E, A, B, R(23) );
-  P( B, C, D, E, A, R(24) );
-  P( A, B, C, D, E, R(25) );
-  P( E, A, B, C, D, R(26) );
-  P( D, E, A, B, C, R(27) );
-  P( C, D, E, A, B, R(28) );
-  P( B, C, D, E, A, R(29) );
-  P( A, B, C, D, E, R(30) );
-  P( E, A, B, C, D, R(31) );
-  P( D, E, A, B, C, R(32) );
-  P( C, D, E, A, B, R(33) );
-  P( B, C, D, E, A, R(34) );
-  P( A, B, C, D, E, R(35) );
-  P( E, A, B, C, D, R(36) );
-  P( D, E, A, B, C, R(37) );
-  P( C, D, E, A, B, R(38) );
-  P( B, C, D, E, A, R(39) );
-
-#undef K
-#undef F
-
-#define F(x,y,z) ((x & y) | (z & (x | y)))
-#define K 0x8F1BBCDC
-
-  P( A, B, C, D, E, R(40) );
-  P( E, A, B, C, D, R(41) );
-  P( D, E, A, B, C, R(42) );
-  P( C, D, E, A, B, R(43) );
-  P( B, C, D, E, A, R(44) );
-  P( A, B, C, D, E, R(45) );
-  P( E, A, B, C, D, R(46) );
-  P( D, E, A, B, C, R(47) );
-  P( C, D, E, A, B, R(48) );
-  P( B, C, D, E, A, R(49) );
-  P( A, B, C, D, E, R(50) );
-  P( E, A, B, C, D, R(51) );
-  P( D, E, A, B, C, R(52) );
-  P( C, D, E, A, B, R(53) );
-  P( B, C, D, E, A, R(54) );
-  P( A, B, C, D, E, R(55) );
-  P( E, A, B, C, D, R(56) );
-  P( D, E, A, B, C, R(57) );
-  P( C, D, E, A, B, R(58) );
-  P( B, C, D, E, A, R(59) );
-
-#undef K
-#undef F
-
-#define F(x,y,z) (x ^ y ^ z)
-#define K 0xCA62C1D6
-
-  P( A, B, C, D, E, R(60) );
-  P( E, A, B, C, D, R(61) );
-  P( D, E, A, B, C, R(62) );
-  P( C, D, E, A, B, R(63) );
-  P( B, C, D, E, A, R(64) );
-  P( A, B, C, D, E, R(65) );
-  P( E, A, B, C, D, R(66) );
-  P( D, E, A, B, C, R(67) );
-  P( C, D, E, A, B, R(68) );
-  P( B, C, D, E, A, R(69) );
-  P( A, B, C, D, E, R(70) );
-  P( E, A, B, C, D, R(71) );
-  P( D, E, A, B, C, R(72) );
-  P( C, D, E, A, B, R(73) );
-  P( B, C, D, E, A, R(74) );
-  P( A, B, C, D, E, R(75) );
-  P( E, A, B, C, D, R(76) );
-  P( D, E, A, B, C, R(77) );
-  P( C, D, E, A, B, R(78) );
-  P( B, C, D, E, A, R(79) );
-
-#undef K
-#undef F
-
-  ctx->state[0] += A;
-  ctx->state[1] += B;
-  ctx->state[2] += C;
-  ctx->state[3] += D;
-  ctx->state[4] += E;
-}
-
-static void
-sha1_update(sha1_context* ctx, const unsigned char* input, unsigned long int length) {
-  unsigned long int left, fill;
-
-  if (!length)
-    return;
+  char* data;       // response data from server, always NUL terminated
+  size_t size;      // response size of data
+  size_t capacity;  // allocated size of data including the NUL
+} MEMFILE;
 
-  left = ctx->total[0] & 0x3F;
-  fill = 64 - left;
+static MEMFILE*
+memfopen() {
+  MEMFILE* mf = (MEMFILE*) malloc(sizeof(MEMFILE));
+  if (mf) {
+    mf->data = NULL;
+    mf->size = 0;
+    mf->capacity = 0;
+  }
+  return mf;
+}
 
-  ctx->total[0] += length;
-  ctx->total[0] &= 0xFFFFFFFF;
+static void
+memfclose(MEMFILE* mf) {
+  if (mf->data) free(mf->data);
+  free(mf);
+}
 
-  if (ctx->total[0] < length)
-    ctx->total[1]++;
+static int
+memfreserve(MEMFILE* mf, size_t size) {
+  char* data;
+  if (size + 1 <= mf->capacity) return TRUE;
+  data = (char*) realloc(mf->data, size + 1);
+  if (!data) return FALSE;
+  mf->data = data;
+  mf->capacity = size + 1;
+  return TRUE;
+}
 
-  if (left && length >= fill) {
-    memcpy((void*)(ctx->buffer + left), (void*) input, fill);
-    sha1_process(ctx, ctx->buffer);
-    length -= fill;
-    input  += fill;
-    left = 0;
+static size_t
+memfwrite(char* ptr, size_t size, size_t nmemb, void* stream) {
+  MEMFILE* mf = (MEMFILE*) stream;
+  size_t block = size * nmemb;
+  if (!mf) return block; // through
+  if (mf->size + block + 1 > mf->capacity) {
+    /* grow geometrically so large bodies are not copied on each chunk */
+    size_t capacity = mf->capacity * 2;
+    if (capacity < MEMFILE_MIN_SIZE) capacity = MEMFILE_MIN_SIZE;
+    if (capacity < mf->size + block + 1) capacity = mf->size + block + 1;
+    if (!memfreserve(mf, capacity - 1)) return 0;
   }
+  memcpy(mf->data + mf->size, ptr, block);
+  mf->size += block;
+  mf->data[mf->size] = 0;
+  return block;
+}
 
-  while (length >= 64) {
-    sha1_process(ctx, input);
-    length -= 64;
-    input  += 64;
-  }
+/* hand the NUL terminated buffer to the caller without copying */
+static char*
+memfdetach(MEMFILE* mf) {
+  char* buf = mf->data;
+  if (mf->size == 0) return NULL;
+  mf->data = NULL;
+  mf->size = 0;
+  mf->capacity = 0;
+  return buf;
+}
+
+/**
+ * API url
+ */
+static gchar*
+get_api_url_alloc(const char* path, ...) {
+  const char* base = application_info.api_url && *application_info.api_url ?
+      application_info.api_url : SERVICE_API_URL;
+  size_t len = strlen(base);
+  va_list args;
+  gchar* tmp;
+  gchar* url;
+
+  va_start(args, path);
+  tmp = g_strdup_vprintf(path, args);
+  va_end(args);
+  if (len > 0 && base[len-1] == '/') len--;
+  url = g_strdup_printf("%.*s%s", (int) len, base, tmp);
+  g_free(tmp);
+  return url;
+}
 
-  if (length)
-    memcpy((void*)(ctx->buffer + left), (void *) input, length );
+/* identifies a request by what it asks for, the signature is in a header */
+static gchar*
+get_request_key_alloc(const char* method, const char* url, const char* postfields) {
+  return g_strdup_printf("%s %s%s%s", method, url,
+          postfields && *postfields ? "\n" : "", postfields ? postfields : "");
 }
 
-static unsigned char
-sha1_padding[64] = {
-  0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
-};
+/**
+ * curl handles
+ *
+ * every transfer runs on the multi handle of the http engine, whose
+ * connection cache hands a live connection to the next transfer to the
+ * same host, so easy handles are simply made for each request. DNS cache
+ * and TLS sessions are shared by every handle in the process.
+ */
+static CURLSH* curl_handle_share = NULL;
+static GMutex* curl_handle_share_mutex[CURL_LOCK_DATA_LAST];
 
 static void
-sha1_finish(sha1_context* ctx, unsigned char digest[20]) {
-  unsigned long int last, padn;
-  unsigned long int high, low;
-  unsigned char msglen[8];
+curl_handle_share_lock(CURL* curl, curl_lock_data data, curl_lock_access access, void* userp) {
+  g_mutex_lock(curl_handle_share_mutex[data]);
+}
 
-  high = (ctx->total[0] >> 29)
-      | (ctx->total[1] <<  3);
-  low  = (ctx->total[0] <<  3);
+static void
+curl_handle_share_unlock(CURL* curl, curl_lock_data data, void* userp) {
+  g_mutex_unlock(curl_handle_share_mutex[data]);
+}
 
-  PUT_UINT32(high, msglen, 0);
-  PUT_UINT32(low,  msglen, 4);
+static void
+curl_handle_init() {
+  int i;
 
-  last = ctx->total[0] & 0x3F;
-  padn = (last < 56) ? (56 - last) : (120 - last);
+  for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+    curl_handle_share_mutex[i] = g_mutex_new();
+  curl_handle_share = curl_share_init();
+  if (!curl_handle_share) return;
+  curl_share_setopt(curl_handle_share, CURLSHOPT_LOCKFUNC, curl_handle_share_lock);
+  curl_share_setopt(curl_handle_share, CURLSHOPT_UNLOCKFUNC, curl_handle_share_unlock);
+  curl_share_setopt(curl_handle_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(curl_handle_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
 
-  sha1_update(ctx, sha1_padding, padn);
-  sha1_update(ctx, msglen, 8);
+static gchar*
+get_url_host_alloc(const char* url) {
+  const char* top = strstr(url, "://");
+  top = top ? top + 3 : url;
+  return g_strndup(url, top - url + strcspn(top, "/?#"));
+}
 
-  PUT_UINT32(ctx->state[0], digest,  0);
-  PUT_UINT32(ctx->state[1], digest,  4);
-  PUT_UINT32(ctx->state[2], digest,  8);
-  PUT_UINT32(ctx->state[3], digest, 12);
-  PUT_UINT32(ctx->state[4], digest, 16);
+static int
+get_idle_time() {
+  return application_info.idle_time > 0 ?
+      application_info.idle_time : CONNECTION_IDLE_TIME;
 }
 
-static unsigned char*
-sha1(const unsigned char* input, unsigned long int size, unsigned char* digest) {
-  sha1_context ctx;
-  sha1_starts(&ctx);
-  sha1_update(&ctx, input, size);
-  sha1_finish(&ctx, digest);
-  return digest;
+static CURL*
+curl_handle_new(const char* url) {
+  CURL* curl = curl_easy_init();
+  if (!curl) return NULL;
+  /* scheme://host:port groups statistics, freed with the handle */
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, get_url_host_alloc(url));
+  curl_easy_setopt(curl, CURLOPT_SHARE, curl_handle_share);
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+#if LIBCURL_VERSION_NUM >= 0x074100
+  curl_easy_setopt(curl, CURLOPT_MAXAGE_CONN, (long) get_idle_time());
+#endif
+  return curl;
 }
 
-static const char hex_table[] = "0123456789abcdef";
+static void
+curl_handle_free(CURL* curl) {
+  char* host = NULL;
 
-static char*
-to_hex_alloc(const char* input) {
-  unsigned long int i, j, len = strlen(input);
-  char* temp = (char*) calloc(len * 2 + 1, sizeof(char));
-  for (i = j = 0; i < len; i++) {
-    temp[j++] = hex_table[((unsigned char) input[i] & 0xF0) >> 4];
-    temp[j++] = hex_table[(unsigned char) input[i]& 0x0F];
-  }
-  return temp;
+  if (!curl) return;
+  curl_easy_getinfo(curl, CURLINFO_PRIVATE, &host);
+  curl_easy_cleanup(curl);
+  g_free(host);
 }
 
-static const char* base64chars =
-"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-"abcdefghijklmnopqrstuvwxyz"
-"0123456789+/";
-#define is_base64(c) ( \
-        isalnum((unsigned char) c) || \
-        ((unsigned char) c == '+') || \
-        ((unsigned char) c == '/'))
+static void
+curl_handle_cleanup() {
+  /* all easy handles are gone, so share is no longer in use */
+  if (curl_handle_share) curl_share_cleanup(curl_handle_share);
+  curl_handle_share = NULL;
+}
 
-static char*
-base64encode_alloc(const char* input, unsigned int size) {
-  int i = 0;
-  int j = 0;
-  unsigned char char_array_3[3] = {0};
-  unsigned char char_array_4[4] = {0};
-  char* temp;
-  char* ret;
-
-  size = size > 0 ? size : strlen(input);
-  ret = temp = (char*) calloc(size * 4 + 1, sizeof(char));
-  while (size--) {
-    char_array_3[i++] = *(input++);
-    if (i == 3) {
-      char_array_4[0] =  (char_array_3[0] & 0xfc) >> 2;
-      char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-      char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-      char_array_4[3] =   char_array_3[2] & 0x3f;
-
-      for (i = 0; i <4; i++)
-        *temp++ = base64chars[char_array_4[i]];
-      i = 0;
-    }
-  }
+/**
+ * http request engine
+ *
+ * all transfers run on one curl multi handle which is driven by the main
+ * loop: sockets and the multi timer are registered as GSources and finished
+ * requests are handed to their callbacks from the main loop. worker threads
+ * may use http_request_perform to wait on a request synchronously.
+ * a GET submitted while an identical one (see get_request_key_alloc) is in
+ * flight is attached to it and gets a copy of its response.
+ *
+ * requests wait in one queue per HTTP_PRIORITY and at most
+ * HTTP_MAX_TRANSFERS run at once, of which background requests may take
+ * HTTP_MAX_BACKGROUND. interactive requests never wait for a slot, and while
+ * one is running background transfers are paused and no new background
+ * request is started.
+ */
+typedef struct _HTTP_REQUEST HTTP_REQUEST;
+typedef void (*HTTP_REQUEST_FUNC)(HTTP_REQUEST* req, gpointer user_data);
+
+/* lower value runs first */
+typedef enum _HTTP_PRIORITY {
+  HTTP_PRIORITY_INTERACTIVE, /* post, favorite, retweet */
+  HTTP_PRIORITY_FOREGROUND,  /* visible timeline */
+  HTTP_PRIORITY_BACKGROUND,  /* avatars, prefetch, hover cards */
+  HTTP_PRIORITY_COUNT
+} HTTP_PRIORITY;
+
+/* seconds from start of the transfer, as reported by curl */
+typedef struct _HTTP_TIMING {
+  double namelookup;
+  double connect;
+  double appconnect;
+  double starttransfer;
+  double total;
+  guint64 wire_bytes;
+  guint64 decoded_bytes;
+} HTTP_TIMING;
+
+/* x-rate-limit-* headers, limit is 0 when the response had none */
+typedef struct _RATE_BUDGET {
+  int limit;
+  int remaining;
+  time_t reset;
+} RATE_BUDGET;
+
+typedef struct _HTTP_REPLAY HTTP_REPLAY;
+
+struct _HTTP_REQUEST {
+  const char* endpoint;
+  gchar* url;
+  const char* method;
+  const char* postfields;
+  gchar* postdata;   /* postfields owned by the request */
+  struct curl_slist* headers;
+  gboolean conditional;
+  gboolean keep_304;
+  HTTP_PRIORITY priority;
+  gboolean running;
+  gboolean paused;
+  CURL* curl;
+  CURLcode res;
+  long http_status;
+  MEMFILE* head;
+  MEMFILE* body;
+  MEMFILE* record;
+  curl_write_callback write_func;
+  void* write_data;
+  HTTP_REPLAY* replay;
+  char error[CURL_ERROR_SIZE];
+  HTTP_REQUEST_FUNC func;
+  gpointer user_data;
+  gboolean done;
+  JSON_Stream* stream;
+  gboolean endless;
+  GAsyncQueue* values;
+  size_t streamed;
+  HTTP_TIMING timing;
+  RATE_BUDGET budget;
+  gchar* key;
+  GSList* followers;
+  volatile gint cancelled;
+};
 
-  if (i) {
-    for(j = i; j < 3; j++)
-      char_array_3[j] = '\0';
+/* response served from replay_dir */
+struct _HTTP_REPLAY {
+  gchar* head;
+  gsize head_size;
+  gchar* body;
+  gsize body_size;
+  gsize offset;
+  GTimer* timer;
+};
 
-    char_array_4[0] =  (char_array_3[0] & 0xfc) >> 2;
-    char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-    char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-    char_array_4[3] =   char_array_3[2] & 0x3f;
+/* recent samples of completed transfers of one endpoint */
+typedef struct _HTTP_STATS {
+  HTTP_TIMING samples[HTTP_STATS_SAMPLES];
+  int count;
+  int next;
+  int cancelled;  /* requests given up before their response */
+  int failed;     /* transfers which ended with an error */
+} HTTP_STATS;
+
+static CURLM* http_multi = NULL;
+static guint http_timer = 0;
+static GThread* http_main_thread = NULL;
+static GAsyncQueue* http_incoming = NULL;
+static GHashTable* http_active = NULL;
+static GHashTable* http_pending = NULL;
+static GQueue* http_waiting[HTTP_PRIORITY_COUNT];
+static int http_running[HTTP_PRIORITY_COUNT];
+static GMutex* http_mutex = NULL;
+static GCond* http_cond = NULL;
+
+/* body bytes as received on the wire and after content decoding */
+static guint64 http_wire_bytes = 0;
+static guint64 http_decoded_bytes = 0;
+
+/* endpoint -> HTTP_STATS, main thread only */
+static GHashTable* http_stats = NULL;
+static FILE* http_log = NULL;
+
+/* timing of the last timeline refresh, shown in the statusbar */
+static HTTP_TIMING http_last_refresh = {0};
+static const char* http_last_refresh_endpoint = NULL;
 
-    for (j = 0; (j < i + 1); j++)
-      *temp++ = base64chars[char_array_4[j]];
+static void
+http_get_timing(HTTP_REQUEST* req) {
+  HTTP_TIMING* timing = &req->timing;
+#if LIBCURL_VERSION_NUM >= 0x073700
+  curl_off_t wire = 0;
+  curl_easy_getinfo(req->curl, CURLINFO_SIZE_DOWNLOAD_T, &wire);
+#else
+  double wire = 0;
+  curl_easy_getinfo(req->curl, CURLINFO_SIZE_DOWNLOAD, &wire);
+#endif
+  curl_easy_getinfo(req->curl, CURLINFO_NAMELOOKUP_TIME, &timing->namelookup);
+  curl_easy_getinfo(req->curl, CURLINFO_CONNECT_TIME, &timing->connect);
+  curl_easy_getinfo(req->curl, CURLINFO_APPCONNECT_TIME, &timing->appconnect);
+  curl_easy_getinfo(req->curl, CURLINFO_STARTTRANSFER_TIME, &timing->starttransfer);
+  curl_easy_getinfo(req->curl, CURLINFO_TOTAL_TIME, &timing->total);
+  timing->wire_bytes = (guint64) wire;
+}
 
-    while((i++ < 3))
-      *temp++ = '=';
-  }
-  *temp = 0;
+static int
+http_compare_double(const void* a, const void* b) {
+  double x = *(const double*) a, y = *(const double*) b;
+  return x < y ? -1 : x > y ? 1 : 0;
+}
 
-  return ret;
+/* percentile (0-100) of total time over the recent samples */
+static double
+http_stats_percentile(HTTP_STATS* stats, int percentile) {
+  double totals[HTTP_STATS_SAMPLES];
+  int n;
+
+  if (!stats || stats->count == 0) return 0;
+  for (n = 0; n < stats->count; n++)
+    totals[n] = stats->samples[n].total;
+  qsort(totals, stats->count, sizeof(double), http_compare_double);
+  return totals[(stats->count - 1) * percentile / 100];
 }
 
-static char*
-urlencode_alloc(const char* url) {
-  unsigned long int i, len = strlen(url);
-  char* temp = (char*) calloc(len * 3 + 1, sizeof(char));
-  char* ret = temp;
-  for (i = 0; i < len; i++) {
-    unsigned char c = (unsigned char) url[i];
-    if (strchr("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_.~-", c))
-      *temp++ = c;
-    else {
-      char buf[3] = {0};
-      snprintf(buf, sizeof(buf), "%02x", c);
-      *temp++ = '%';
-      *temp++ = toupper(buf[0]);
-      *temp++ = toupper(buf[1]);
-    }
+/* endpoint as a JSON string */
+static gchar*
+http_log_quote_alloc(const char* str) {
+  GString* ret = g_string_new("\"");
+  for (; *str; str++) {
+    unsigned char c = (unsigned char) *str;
+    if (c == '"' || c == '\\')
+      g_string_append_printf(ret, "\\%c", c);
+    else if (c < 0x20)
+      g_string_append_printf(ret, "\\u%04x", c);
+    else
+      g_string_append_c(ret, c);
   }
-  *temp = 0;
-
-  return ret;
+  g_string_append_c(ret, '"');
+  return g_string_free(ret, FALSE);
 }
 
-static unsigned char*
-hmac(const unsigned char* key, unsigned int keylen, const unsigned char* data, unsigned int datalen, unsigned char* digest) {
-  int i;
-  sha1_context ctx;
-  unsigned char ipad[65] = {0};
-  unsigned char opad[65] = {0};
-  unsigned char inner[21] = {0};
-
-  memset(ipad, 0, sizeof(ipad));
-  memset(opad, 0, sizeof(opad));
-
-  if (keylen > 64) {
-    unsigned char keydigest[21];
-    sha1_starts(&ctx);
-    sha1_update(&ctx, key, keylen);
-    sha1_finish(&ctx, keydigest);
-    memcpy(ipad, keydigest, 20);
-    memcpy(opad, keydigest, 20);
+static void
+http_stats_record(HTTP_REQUEST* req) {
+  HTTP_STATS* stats;
+  HTTP_TIMING* timing = &req->timing;
+  char* host = NULL;
+  const char* endpoint = req->endpoint;
+  gchar* quoted;
+
+  /* requests without endpoint (avatars, short urls) are grouped by host */
+  if (!endpoint) {
+    curl_easy_getinfo(req->curl, CURLINFO_PRIVATE, &host);
+    endpoint = host ? host : "unknown";
   }
-  else {
-    memcpy(ipad, key, keylen);
-    memcpy(opad, key, keylen);
+  stats = (HTTP_STATS*) g_hash_table_lookup(http_stats, endpoint);
+  if (!stats) {
+    stats = (HTTP_STATS*) g_malloc0(sizeof(HTTP_STATS));
+    g_hash_table_insert(http_stats, g_strdup(endpoint), stats);
   }
-
-  for (i = 0; i < 64; i++) {
-    ipad[i] ^= 0x36;
-    opad[i] ^= 0x5c;
+  /* only complete transfers tell how long a response takes */
+  if (req->res == CURLE_ABORTED_BY_CALLBACK || g_atomic_int_get(&req->cancelled))
+    stats->cancelled++;
+  else if (req->res != CURLE_OK || timing->total <= 0)
+    stats->failed++;
+  else {
+    stats->samples[stats->next] = *timing;
+    stats->next = (stats->next + 1) % HTTP_STATS_SAMPLES;
+    if (stats->count < HTTP_STATS_SAMPLES) stats->count++;
   }
 
-  sha1_starts(&ctx);
-  sha1_update(&ctx, ipad, 64);
-  sha1_update(&ctx, data, datalen);
-  sha1_finish(&ctx, inner);
+  if (!application_info.log_file || !*application_info.log_file) return;
+  if (!http_log) http_log = fopen(application_info.log_file, "a");
+  if (!http_log) return;
+  /* one JSON object per line */
+  quoted = http_log_quote_alloc(endpoint);
+  fprintf(http_log,
+          "{\"time\":%d,\"endpoint\":%s,\"result\":%d,\"status\":%ld,"
+          "\"namelookup\":%.6f,\"connect\":%.6f,\"appconnect\":%.6f,"
+          "\"starttransfer\":%.6f,\"total\":%.6f,"
+          "\"wire_bytes\":%" G_GUINT64_FORMAT ",\"decoded_bytes\":%" G_GUINT64_FORMAT ","
+          "\"p50\":%.6f,\"p90\":%.6f,\"p99\":%.6f,"
+          "\"cancelled\":%d,\"failed\":%d}\n",
+          (int) time(0), quoted, (int) req->res, req->http_status,
+          timing->namelookup, timing->connect, timing->appconnect,
+          timing->starttransfer, timing->total,
+          timing->wire_bytes, timing->decoded_bytes,
+          http_stats_percentile(stats, 50),
+          http_stats_percentile(stats, 90),
+          http_stats_percentile(stats, 99),
+          stats->cancelled, stats->failed);
+  fflush(http_log);
+  g_free(quoted);
+}
 
-  sha1_starts(&ctx);
-  sha1_update(&ctx, opad, 64);
-  sha1_update(&ctx, inner, 20);
-  sha1_finish(&ctx, digest);
+/**
+ * rate limit
+ *
+ * budgets are taken from the x-rate-limit-* headers of every response and
+ * kept per endpoint. background work (polls, prefetches, hover cards) only
+ * spends calls above RATE_LIMIT_RESERVE, which is left for requests the
+ * user asked for.
+ */
+static GHashTable* rate_budgets = NULL;
+static GStaticMutex rate_budget_mutex = G_STATIC_MUTEX_INIT;
 
-  return digest;
+static void
+rate_budget_store(const char* endpoint, const RATE_BUDGET* budget) {
+  RATE_BUDGET* stored;
+
+  g_static_mutex_lock(&rate_budget_mutex);
+  if (!rate_budgets)
+    rate_budgets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  stored = (RATE_BUDGET*) g_hash_table_lookup(rate_budgets, endpoint);
+  if (!stored) {
+    stored = (RATE_BUDGET*) g_malloc0(sizeof(RATE_BUDGET));
+    g_hash_table_insert(rate_budgets, g_strdup(endpoint), stored);
+  }
+  *stored = *budget;
+  g_static_mutex_unlock(&rate_budget_mutex);
 }
 
-static char*
-get_nonce_alloc() {
-  char buf[64] = {0};
-  char digest[256] = {0};
-  snprintf(buf, sizeof(buf), "%d %d", (int) time(0), (int) random());
-  sha1((const unsigned char*) buf, strlen(buf), (unsigned char*) digest);
-  return to_hex_alloc(digest);
+/* copy of the budget of endpoint, FALSE if unknown or already reset */
+static gboolean
+rate_budget_lookup(const char* endpoint, RATE_BUDGET* budget) {
+  RATE_BUDGET* stored = NULL;
+
+  if (!endpoint) return FALSE;
+  g_static_mutex_lock(&rate_budget_mutex);
+  if (rate_budgets)
+    stored = (RATE_BUDGET*) g_hash_table_lookup(rate_budgets, endpoint);
+  if (stored) *budget = *stored;
+  g_static_mutex_unlock(&rate_budget_mutex);
+  return stored && budget->reset > time(0);
 }
 
-typedef struct {
-  char* data;     // response data from server
-  size_t size;    // response size of data
-} MEMFILE;
+/* whether one more call of endpoint may be spent now */
+static gboolean
+rate_budget_allows(const char* endpoint, gboolean background) {
+  RATE_BUDGET budget;
 
-static MEMFILE*
-memfopen() {
-  MEMFILE* mf = (MEMFILE*) malloc(sizeof(MEMFILE));
-  if (mf) {
-    mf->data = NULL;
-    mf->size = 0;
-  }
-  return mf;
+  if (!rate_budget_lookup(endpoint, &budget)) return TRUE;
+  if (background) return budget.remaining > RATE_LIMIT_RESERVE;
+  return budget.remaining > 0;
 }
 
+/* milliseconds until the next background poll of endpoint, at least span */
+static guint
+rate_budget_interval(const char* endpoint, guint span) {
+  RATE_BUDGET budget;
+  int spare;
+  guint wait;
+
+  if (!rate_budget_lookup(endpoint, &budget)) return span;
+  wait = (guint) (budget.reset - time(0)) * 1000;
+  spare = budget.remaining - RATE_LIMIT_RESERVE;
+  /* nothing to spare, wait for the reset */
+  if (spare <= 0) return wait + 1000;
+  /* spread what is left evenly over the window */
+  wait /= spare;
+  return wait > span ? wait : span;
+}
+
+/* ptr is a header line of block bytes from curl, not NUL terminated */
 static void
-memfclose(MEMFILE* mf) {
-  if (mf->data) free(mf->data);
-  free(mf);
+http_header_budget(HTTP_REQUEST* req, const char* ptr, size_t block) {
+  const char* name = ptr + 13;
+  const char* colon;
+  char value[32];
+  size_t len;
+
+  if (block < 14 || g_ascii_strncasecmp(ptr, "x-rate-limit-", 13)) return;
+  colon = (const char*) memchr(name, ':', block - 13);
+  if (!colon) return;
+  len = block - (colon + 1 - ptr);
+  if (len >= sizeof(value)) len = sizeof(value) - 1;
+  memcpy(value, colon + 1, len);
+  value[len] = 0;
+
+  len = colon - name;
+  if (len == 5 && !g_ascii_strncasecmp(name, "limit", 5))
+    req->budget.limit = atoi(value);
+  else if (len == 9 && !g_ascii_strncasecmp(name, "remaining", 9))
+    req->budget.remaining = atoi(value);
+  else if (len == 5 && !g_ascii_strncasecmp(name, "reset", 5))
+    req->budget.reset = (time_t) strtol(value, NULL, 10);
 }
 
-static size_t
-memfwrite(char* ptr, size_t size, size_t nmemb, void* stream) {
-  MEMFILE* mf = (MEMFILE*) stream;
-  int block = size * nmemb;
-  if (!mf) return block; // through
-  if (!mf->data)
-    mf->data = (char*) malloc(block);
-  else
-    mf->data = (char*) realloc(mf->data, mf->size + block);
-  if (mf->data) {
-    memcpy(mf->data + mf->size, ptr, block);
-    mf->size += block;
-  }
-  return block;
+/**
+ * record/replay
+ *
+ * with record_dir every response is saved under a name derived from
+ * get_request_key_alloc. with replay_dir responses are served from those
+ * files instead of the network, after replay_latency milliseconds and at
+ * replay_bandwidth bytes per second.
+ */
+static gchar*
+http_record_path_alloc(const char* dir, HTTP_REQUEST* req, const char* ext) {
+  gchar* key = get_request_key_alloc(req->method, req->url, req->postfields);
+  gchar* name = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key, -1);
+  gchar* file = g_strconcat(name, ext, NULL);
+  gchar* path = g_build_filename(dir, file, NULL);
+  g_free(file);
+  g_free(name);
+  g_free(key);
+  return path;
 }
 
-static char*
-memfstrdup(MEMFILE* mf) {
-  char* buf;
-  if (mf->size == 0) return NULL;
-  buf = (char*) malloc(mf->size + 1);
-  memcpy(buf, mf->data, mf->size);
-  buf[mf->size] = 0;
-  return buf;
+static void
+http_record_save(HTTP_REQUEST* req) {
+  const char* dir = application_info.record_dir;
+  gchar* key;
+  gchar* path;
+
+  g_mkdir_with_parents(dir, 0700);
+  key = get_request_key_alloc(req->method, req->url, req->postfields);
+  path = http_record_path_alloc(dir, req, ".key");
+  g_file_set_contents(path, key, -1, NULL);
+  g_free(path);
+  g_free(key);
+  path = http_record_path_alloc(dir, req, ".head");
+  g_file_set_contents(path, req->head->data ? req->head->data : "", req->head->size, NULL);
+  g_free(path);
+  path = http_record_path_alloc(dir, req, ".body");
+  g_file_set_contents(path, req->record->data ? req->record->data : "", req->record->size, NULL);
+  g_free(path);
 }
 
+static void http_request_add_header(HTTP_REQUEST* req, const char* header);
+
 /**
- * timer register
+ * conditional requests
+ *
+ * validators (ETag, Last-Modified) and the body of the last 200 response
+ * are kept per request key in the XDG cache dir, so even the first request
+ * after a restart can be answered with 304. unless the caller asked to see
+ * the 304, it is turned into a 200 with the cached body.
  */
-static guint
-reload_timer_func(gpointer data) {
-  GtkWidget* window = (GtkWidget*) data;
-  gchar* old_data;
+typedef struct _HTTP_CONDITION {
+  gchar* etag;
+  gchar* last_modified;
+} HTTP_CONDITION;
 
-  old_data = g_object_get_data(G_OBJECT(window), "last_status_id");
-  if (old_data) g_free(old_data);
-  g_object_set_data(G_OBJECT(window), "last_status_id", NULL);
-  old_data = g_object_get_data(G_OBJECT(window), "page");
-  if (old_data) g_free(old_data);
-  g_object_set_data(G_OBJECT(window), "page", NULL);
+/* sha1 of request key -> HTTP_CONDITION */
+static GHashTable* http_conditions = NULL;
+static GStaticMutex http_condition_mutex = G_STATIC_MUTEX_INIT;
 
-  gdk_threads_enter();
-  update_timeline(window, NULL);
-  gdk_threads_leave();
-  return 0;
+static void
+http_condition_free(HTTP_CONDITION* cond) {
+  g_free(cond->etag);
+  g_free(cond->last_modified);
+  g_free(cond);
+}
+
+static gchar*
+http_condition_path_alloc(const char* name) {
+  return g_build_filename(g_get_user_cache_dir(), APP_NAME, name, NULL);
 }
 
 static void
-stop_reload_timer(GtkWidget* window) {
-  if (reload_timer != 0) {
-    g_source_remove(reload_timer);
-    reload_timer = 0;
+http_condition_load() {
+  gchar* path = http_condition_path_alloc(HTTP_CONDITION_FILE);
+  gchar* contents = NULL;
+  gchar** lines;
+  int n;
+
+  http_conditions = g_hash_table_new_full(g_str_hash, g_str_equal,
+          g_free, (GDestroyNotify) http_condition_free);
+  if (g_file_get_contents(path, &contents, NULL, NULL)) {
+    /* name \t etag \t last-modified */
+    lines = g_strsplit(contents, "\n", -1);
+    for (n = 0; lines[n]; n++) {
+      gchar** fields = g_strsplit(lines[n], "\t", 3);
+      if (fields[0] && fields[1] && fields[2]) {
+        HTTP_CONDITION* cond = (HTTP_CONDITION*) g_malloc0(sizeof(HTTP_CONDITION));
+        if (*fields[1]) cond->etag = g_strdup(fields[1]);
+        if (*fields[2]) cond->last_modified = g_strdup(fields[2]);
+        g_hash_table_replace(http_conditions, g_strdup(fields[0]), cond);
+      }
+      g_strfreev(fields);
+    }
+    g_strfreev(lines);
+    g_free(contents);
   }
+  g_free(path);
 }
 
 static void
-start_reload_timer(GtkWidget* window) {
-  stop_reload_timer(window);
-  reload_timer = g_timeout_add_full(
-          G_PRIORITY_LOW,
-          RELOAD_TIMER_SPAN,
-          (GSourceFunc) reload_timer_func,
-          window,
-          NULL);
+http_condition_save() {
+  gchar* path = http_condition_path_alloc(HTTP_CONDITION_FILE);
+  gchar* dir = g_path_get_dirname(path);
+  GString* contents = g_string_new(NULL);
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_static_mutex_lock(&http_condition_mutex);
+  g_hash_table_iter_init(&iter, http_conditions);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    HTTP_CONDITION* cond = (HTTP_CONDITION*) value;
+    g_string_append_printf(contents, "%s\t%s\t%s\n", (gchar*) key,
+            cond->etag ? cond->etag : "",
+            cond->last_modified ? cond->last_modified : "");
+  }
+  g_static_mutex_unlock(&http_condition_mutex);
+  g_mkdir_with_parents(dir, 0700);
+  g_file_set_contents(path, contents->str, contents->len, NULL);
+  g_string_free(contents, TRUE);
+  g_free(dir);
+  g_free(path);
 }
 
+/* send validators of the previous response, call before submitting */
 static void
-reset_reload_timer(GtkWidget* window) {
-  stop_reload_timer(window);
-  start_reload_timer(window);
+http_request_set_conditional(HTTP_REQUEST* req, gboolean keep_304) {
+  HTTP_CONDITION* cond;
+  gchar* name;
+  gchar* header = NULL;
+
+  req->conditional = TRUE;
+  req->keep_304 = keep_304;
+  if (!req->key)
+    req->key = get_request_key_alloc(req->method, req->url, req->postfields);
+  name = g_compute_checksum_for_string(G_CHECKSUM_SHA1, req->key, -1);
+  g_static_mutex_lock(&http_condition_mutex);
+  cond = (HTTP_CONDITION*) g_hash_table_lookup(http_conditions, name);
+  if (cond && cond->etag)
+    header = g_strdup_printf("If-None-Match: %s", cond->etag);
+  else if (cond && cond->last_modified)
+    header = g_strdup_printf("If-Modified-Since: %s", cond->last_modified);
+  g_static_mutex_unlock(&http_condition_mutex);
+  if (header) http_request_add_header(req, header);
+  g_free(header);
+  g_free(name);
 }
 
-static char*
-get_http_header_alloc(const char* ptr, const char* key) {
-  const char* tmp = ptr;
+/* turn a 304 into a 200 with the cached body, FALSE if it is gone */
+static gboolean
+http_condition_replay(HTTP_REQUEST* req, const gchar* name, const gchar* path) {
+  gchar* contents = NULL;
+  gsize size = 0;
+
+  if (!g_file_get_contents(path, &contents, &size, NULL)) {
+    /* cached body is gone, next request must not be conditional */
+    g_static_mutex_lock(&http_condition_mutex);
+    g_hash_table_remove(http_conditions, name);
+    g_static_mutex_unlock(&http_condition_mutex);
+    return FALSE;
+  }
+  req->http_status = 200;
+  if (size) req->write_func(contents, 1, size, req->write_data);
+  g_free(contents);
+  return TRUE;
+}
 
-  while (*ptr) {
-    tmp = strpbrk(ptr, "\r\n");
-    if (!tmp) break;
-    if (!strncasecmp(ptr, key, strlen(key)) && *(ptr + strlen(key)) == ':') {
-      size_t len;
-      char* val;
-      const char* top = ptr + strlen(key) + 1;
-      while (*top && isspace(*top)) top++;
-      if (!*top) return NULL;
-      len = tmp - top + 1;
-      val = malloc(len);
-      memset(val, 0, len);
-      strncpy(val, top, len-1);
-      return val;
+/* remember validators of a 200, answer a 304 from the cache */
+static void
+http_condition_update(HTTP_REQUEST* req) {
+  gchar* name = g_compute_checksum_for_string(G_CHECKSUM_SHA1, req->key, -1);
+  gchar* file = g_strconcat(name, ".body", NULL);
+  gchar* path = http_condition_path_alloc(file);
+  char* etag = NULL;
+  char* last_modified = NULL;
+  MEMFILE* body = req->record ? req->record : req->body;
+
+  if (req->http_status == 200 && req->head->data) {
+    etag = get_http_header_alloc(req->head->data, "ETag");
+    last_modified = get_http_header_alloc(req->head->data, "Last-Modified");
+  }
+  if (etag || last_modified) {
+    HTTP_CONDITION* cond = (HTTP_CONDITION*) g_malloc0(sizeof(HTTP_CONDITION));
+    gchar* dir = g_path_get_dirname(path);
+    cond->etag = etag ? g_strdup(etag) : NULL;
+    cond->last_modified = last_modified ? g_strdup(last_modified) : NULL;
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+    if (g_file_set_contents(path, body->data ? body->data : "", body->size, NULL)) {
+      g_static_mutex_lock(&http_condition_mutex);
+      g_hash_table_replace(http_conditions, g_strdup(name), cond);
+      g_static_mutex_unlock(&http_condition_mutex);
+    } else {
+      http_condition_free(cond);
     }
-    ptr = tmp + 1;
+  } else if (req->http_status == 304 && !req->keep_304) {
+    http_condition_replay(req, name, path);
   }
-  return NULL;
+  if (etag) free(etag);
+  if (last_modified) free(last_modified);
+  g_free(path);
+  g_free(file);
+  g_free(name);
 }
 
-static char*
-get_short_url_alloc(const char* url) {
-  gchar* purl;
-  CURL* curl;
-  MEMFILE* mf; // mem file
-  char* ret = NULL;
-
-  purl = g_strdup_printf(SHORTURL_API_URL, url);
-
-  mf = memfopen();
-  curl = curl_easy_init();
-  curl_easy_setopt(curl, CURLOPT_URL, purl);
-  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, mf);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-  curl_easy_perform(curl);
-  curl_easy_cleanup(curl);
+static void http_request_stopped(HTTP_REQUEST* req);
+static void http_schedule();
 
-  g_free(purl);
-  ret = memfstrdup(mf);
-  memfclose(mf);
+/* give a coalesced request the result of the transfer it was attached to */
+static void
+http_request_follow(HTTP_REQUEST* req, HTTP_REQUEST* leader) {
+  req->res = leader->res;
+  req->http_status = leader->http_status;
+  memcpy(req->error, leader->error, sizeof(req->error));
+  if (leader->head->size)
+    memfwrite(leader->head->data, 1, leader->head->size, req->head);
+  if (leader->body->size)
+    req->write_func(leader->body->data, 1, leader->body->size, req->write_data);
+  /* a leader which kept its 304 has no body for a follower which can't */
+  if (req->res == CURLE_OK && req->http_status == 304 && !req->keep_304 && req->key) {
+    gchar* name = g_compute_checksum_for_string(G_CHECKSUM_SHA1, req->key, -1);
+    gchar* file = g_strconcat(name, ".body", NULL);
+    gchar* path = http_condition_path_alloc(file);
+    http_condition_replay(req, name, path);
+    g_free(path);
+    g_free(file);
+    g_free(name);
+  }
+  if (req->func) req->func(req, req->user_data);
+}
 
-  return ret;
+static void
+http_request_complete(HTTP_REQUEST* req, CURLcode res) {
+  GSList* followers;
+
+  if (req->key && g_hash_table_lookup(http_pending, req->key) == req)
+    g_hash_table_remove(http_pending, req->key);
+  if (req->running) http_request_stopped(req);
+  req->res = res;
+  if (!req->replay) {
+    if (res == CURLE_OK)
+      curl_easy_getinfo(req->curl, CURLINFO_HTTP_CODE, &req->http_status);
+    http_get_timing(req);
+  }
+  req->timing.decoded_bytes = req->body->size + req->streamed;
+  http_wire_bytes += req->timing.wire_bytes;
+  http_decoded_bytes += req->timing.decoded_bytes;
+  http_stats_record(req);
+  if (res == CURLE_OK && req->endpoint && req->budget.limit > 0)
+    rate_budget_store(req->endpoint, &req->budget);
+  if (res == CURLE_OK && req->record && !req->replay &&
+          application_info.record_dir && *application_info.record_dir)
+    http_record_save(req);
+  if (res == CURLE_OK && req->conditional)
+    http_condition_update(req);
+
+  /* followers first, req may be gone once its own callback returned */
+  followers = g_slist_reverse(req->followers);
+  req->followers = NULL;
+  while (followers) {
+    http_request_follow((HTTP_REQUEST*) followers->data, req);
+    followers = g_slist_delete_link(followers, followers);
+  }
+  if (req->func) req->func(req, req->user_data);
+  http_schedule();
 }
 
-static char*
-get_short_status_alloc(const char* status) {
-  const char* ptr = status;
-  const char* last = ptr;
-  char* ret = NULL;
-  int len = 0;
-  while(*ptr) {
-    if (!strncmp(ptr, "http://", 7) || !strncmp(ptr, "ftp://", 6)) {
-      char* link;
-      char* short_url;
-      const char* tmp;
+static void
+http_replay_free(HTTP_REPLAY* replay) {
+  g_free(replay->head);
+  g_free(replay->body);
+  g_timer_destroy(replay->timer);
+  g_free(replay);
+}
 
-      if (last != ptr) {
-        len += (ptr-last);
-        if (!ret) {
-          ret = malloc(len+1);
-          memset(ret, 0, len+1);
-        } else ret = realloc(ret, len+1);
-        strncat(ret, last, ptr-last);
-      }
+static size_t http_header_func(char* ptr, size_t size, size_t nmemb, void* stream);
+static size_t http_write_func(char* ptr, size_t size, size_t nmemb, void* stream);
 
-      tmp = ptr;
-      while(*tmp && strchr(ACCEPT_LETTER_URL, *tmp)) tmp++;
-      link = malloc(tmp-ptr+1);
-      memset(link, 0, tmp-ptr+1);
-      memcpy(link, ptr, tmp-ptr);
-      short_url = get_short_url_alloc(link);
-      if (short_url) {
-        free(link);
-        link = short_url;
-      }
+static gboolean
+http_replay_event(gpointer data) {
+  HTTP_REQUEST* req = (HTTP_REQUEST*) data;
+  HTTP_REPLAY* replay = req->replay;
+  gsize block = replay->body_size - replay->offset;
 
-      len += strlen(link);
-      if (!ret) {
-        ret = malloc(len+1);
-        memset(ret, 0, len+1);
-      } else ret = realloc(ret, len+1);
-      strcat(ret, link);
-      free(link);
-      ptr = last = tmp;
-    } else
-      ptr++;
+  if (g_atomic_int_get(&req->cancelled) && !req->followers) {
+    http_request_complete(req, CURLE_ABORTED_BY_CALLBACK);
+    return FALSE;
   }
-  if (last != ptr) {
-    len += (ptr-last);
-    if (!ret) {
-      ret = malloc(len+1);
-      memset(ret, 0, len+1);
-    } else ret = realloc(ret, len+1);
-    strncat(ret, last, ptr-last);
+  if (replay->offset == 0) {
+    /* headers at once, one line per call like curl does */
+    gchar* ptr = replay->head;
+    gchar* end = replay->head + replay->head_size;
+    while (ptr < end) {
+      gchar* eol = memchr(ptr, '\n', end - ptr);
+      gsize len = eol ? eol - ptr + 1 : end - ptr;
+      http_header_func(ptr, 1, len, req);
+      ptr += len;
+    }
+    req->timing.starttransfer = g_timer_elapsed(replay->timer, NULL);
   }
-  return ret;
+  if (application_info.replay_bandwidth > 0) {
+    gsize limit = (gsize) application_info.replay_bandwidth * HTTP_REPLAY_TICK / 1000;
+    if (limit == 0) limit = 1;
+    if (block > limit) block = limit;
+  }
+  if (block > 0)
+    http_write_func(replay->body + replay->offset, 1, block, req);
+  replay->offset += block;
+
+  if (replay->offset < replay->body_size) {
+    g_timeout_add(HTTP_REPLAY_TICK, http_replay_event, req);
+    return FALSE;
+  }
+  req->timing.total = g_timer_elapsed(replay->timer, NULL);
+  req->timing.wire_bytes = replay->body_size;
+  http_request_complete(req, CURLE_OK);
+  return FALSE;
 }
 
-/**
- * oAuth
- */
-static char*
-get_request_token_alloc(
-        const char* consumer_key,
-        const char* consumer_secret) {
+static void
+http_replay_start(HTTP_REQUEST* req) {
+  const char* dir = application_info.replay_dir;
+  HTTP_REPLAY* replay = (HTTP_REPLAY*) g_malloc0(sizeof(HTTP_REPLAY));
+  gchar* head_path = http_record_path_alloc(dir, req, ".head");
+  gchar* body_path = http_record_path_alloc(dir, req, ".body");
+
+  replay->timer = g_timer_new();
+  req->replay = replay;
+  if (!g_file_get_contents(head_path, &replay->head, &replay->head_size, NULL) ||
+          !g_file_get_contents(body_path, &replay->body, &replay->body_size, NULL)) {
+    snprintf(req->error, sizeof(req->error), "no recorded response for %s", req->url);
+    http_request_complete(req, CURLE_COULDNT_CONNECT);
+  } else {
+    g_timeout_add(application_info.replay_latency > 0 ?
+            application_info.replay_latency : 0, http_replay_event, req);
+  }
+  g_free(head_path);
+  g_free(body_path);
+}
 
-  char* key = NULL;
-  char* query = NULL;
-  char* nonce;
-  char* ptr = NULL;
-  char* tmp = NULL;
-  char* purl = NULL;
-  char auth[21];
-  char error[CURL_ERROR_SIZE] = {0};
-  MEMFILE* mf; // mem file
-  CURL* curl;
-  CURLcode res = CURLE_OK;
+static void
+http_check_multi_info() {
+  CURLMsg* msg;
+  int pending;
+
+  while ((msg = curl_multi_info_read(http_multi, &pending))) {
+    HTTP_REQUEST* req;
+    CURL* curl = msg->easy_handle;
+    CURLcode res = msg->data.result;
+
+    if (msg->msg != CURLMSG_DONE) continue;
+    curl_multi_remove_handle(http_multi, curl);
+    req = (HTTP_REQUEST*) g_hash_table_lookup(http_active, curl);
+    g_hash_table_remove(http_active, curl);
+    if (!req) continue;
+    http_request_complete(req, res);
+  }
+}
 
-  nonce = get_nonce_alloc();
-  query = g_strdup_printf(
-          "oauth_consumer_key=%s"
-          "&oauth_nonce=%s"
-          "&oauth_request_method=POST"
-          "&oauth_signature_method=HMAC-SHA1"
-          "&oauth_timestamp=%d"
-          "&oauth_version=1.0",
-          consumer_key,
-          nonce,
-          (int) time(0));
-  free(nonce);
+static gboolean
+http_socket_event(GIOChannel* channel, GIOCondition cond, gpointer data) {
+  int running = 0;
+  int action = 0;
+
+  if (cond & (G_IO_IN | G_IO_PRI | G_IO_HUP)) action |= CURL_CSELECT_IN;
+  if (cond & G_IO_OUT) action |= CURL_CSELECT_OUT;
+  if (cond & (G_IO_ERR | G_IO_NVAL)) action |= CURL_CSELECT_ERR;
+  curl_multi_socket_action(http_multi, (curl_socket_t) GPOINTER_TO_INT(data),
+          action, &running);
+  http_check_multi_info();
+  return TRUE;
+}
 
-  purl = urlencode_alloc(SERVICE_REQUEST_TOKEN_URL);
-  ptr = urlencode_alloc(query);
-  tmp = g_strdup_printf("POST&%s&%s", purl, ptr);
-  free(purl);
-  free(ptr);
-  key = g_strdup_printf("%s&", consumer_secret);
-  hmac((unsigned char*) key, strlen(key),
-          (unsigned char*) tmp, strlen(tmp), (unsigned char*) auth);
-  g_free(key);
-  g_free(tmp);
-  tmp = base64encode_alloc(auth, 20);
-  ptr = urlencode_alloc(tmp);
-  free(tmp);
-  tmp = g_strdup_printf("%s&oauth_signature=%s", query, ptr);
-  free(ptr);
-  g_free(query);
-  query = tmp;
-
-  mf = memfopen();
-  curl = curl_easy_init();
-  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error);
-  curl_easy_setopt(curl, CURLOPT_URL, SERVICE_REQUEST_TOKEN_URL);
-  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_POST, 1);
-  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, query);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, mf);
-  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-  res = curl_easy_perform(curl);
-  curl_easy_cleanup(curl);
-  if (res != CURLE_OK) {
-    fputs(error, stderr);
-    ptr = NULL;
-  } else {
-    ptr = memfstrdup(mf);
+static int
+http_socket_func(CURL* curl, curl_socket_t s, int what, void* userp, void* socketp) {
+  guint* watch = (guint*) socketp;
+  GIOChannel* channel;
+  GIOCondition cond = G_IO_ERR | G_IO_HUP;
+
+  if (watch && *watch) {
+    g_source_remove(*watch);
+    *watch = 0;
   }
-  g_free(query);
-  memfclose(mf);
-  return ptr;
+  if (what == CURL_POLL_REMOVE) {
+    g_free(watch);
+    curl_multi_assign(http_multi, s, NULL);
+    return 0;
+  }
+  if (!watch) {
+    watch = (guint*) g_malloc0(sizeof(guint));
+    curl_multi_assign(http_multi, s, watch);
+  }
+  if (what & CURL_POLL_IN) cond |= G_IO_IN | G_IO_PRI;
+  if (what & CURL_POLL_OUT) cond |= G_IO_OUT;
+#ifdef _WIN32
+  channel = g_io_channel_win32_new_socket(s);
+#else
+  channel = g_io_channel_unix_new(s);
+#endif
+  *watch = g_io_add_watch(channel, cond, http_socket_event, GINT_TO_POINTER(s));
+  g_io_channel_unref(channel);
+  return 0;
 }
 
-static char*
-get_access_token_alloc(
-        const char* consumer_key,
-        const char* consumer_secret,
-        const char* request_token,
-        const char* request_token_secret,
-        const char* verifier) {
-
-  char* key;
-  char* query;
-  char* nonce;
-  char* ptr = NULL;
-  char* tmp;
-  char* purl;
-  char auth[21];
-  char error[CURL_ERROR_SIZE];
-  MEMFILE* mf; // mem file
-  CURL* curl;
-  CURLcode res = CURLE_OK;
+static gboolean
+http_timeout_event(gpointer data) {
+  int running = 0;
+  http_timer = 0;
+  curl_multi_socket_action(http_multi, CURL_SOCKET_TIMEOUT, 0, &running);
+  http_check_multi_info();
+  return FALSE;
+}
 
-  nonce = get_nonce_alloc();
-  query = g_strdup_printf(
-          "oauth_consumer_key=%s"
-          "&oauth_nonce=%s"
-          "&oauth_request_method=POST"
-          "&oauth_signature_method=HMAC-SHA1"
-          "&oauth_timestamp=%d"
-          "&oauth_token=%s"
-          "&oauth_token_secret=%s"
-          "&oauth_verifier=%s"
-          "&oauth_version=1.0",
-          consumer_key,
-          nonce,
-          (int) time(0),
-          request_token,
-          request_token_secret,
-          verifier);
-  free(nonce);
+static int
+http_timer_func(CURLM* multi, long timeout_ms, void* userp) {
+  if (http_timer) {
+    g_source_remove(http_timer);
+    http_timer = 0;
+  }
+  if (timeout_ms >= 0)
+    http_timer = g_timeout_add(timeout_ms, http_timeout_event, NULL);
+  return 0;
+}
 
-  purl = urlencode_alloc(SERVICE_ACCESS_TOKEN_URL);
-  ptr = urlencode_alloc(query);
-  tmp = g_strdup_printf("POST&%s&%s", purl, ptr);
-  free(purl);
-  free(ptr);
-  key = g_strdup_printf("%s&", consumer_secret);
-  hmac((unsigned char*) key, strlen(key),
-          (unsigned char*) tmp, strlen(tmp), (unsigned char*) auth);
-  g_free(key);
-  g_free(tmp);
-  tmp = base64encode_alloc(auth, 20);
-  ptr = urlencode_alloc(tmp);
-  tmp = g_strdup_printf("%s&oauth_signature=%s", query, ptr);
-  free(ptr);
-  g_free(query);
-  query = tmp;
-
-  mf = memfopen();
-  curl = curl_easy_init();
-  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error);
-  curl_easy_setopt(curl, CURLOPT_URL, SERVICE_ACCESS_TOKEN_URL);
-  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_POST, 1);
-  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, query);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, mf);
-  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-  res = curl_easy_perform(curl);
-  curl_easy_cleanup(curl);
-  if (res != CURLE_OK) {
-    fputs(error, stderr);
-    ptr = NULL;
-  } else {
-    ptr = memfstrdup(mf);
+/* pause or resume every running background transfer */
+static void
+http_pause_background(gboolean pause) {
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init(&iter, http_active);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    HTTP_REQUEST* req = (HTTP_REQUEST*) value;
+    if (req->priority != HTTP_PRIORITY_BACKGROUND || req->paused == pause)
+      continue;
+    req->paused = pause;
+    curl_easy_pause(req->curl, pause ? CURLPAUSE_ALL : CURLPAUSE_CONT);
   }
-  g_free(query);
-  memfclose(mf);
-  return ptr;
 }
 
-/**
- * get pixbuf from URL
- */
-static GdkPixbuf*
-url2pixbuf(const char* url, GError** error) {
-  GdkPixbuf* pixbuf = NULL;
-  GdkPixbufLoader* loader = NULL;
-  GError* _error = NULL;
+static void
+http_request_start(HTTP_REQUEST* req) {
+  req->running = TRUE;
+  /* background transfers give way while the user waits */
+  if (++http_running[req->priority] == 1 &&
+          req->priority == HTTP_PRIORITY_INTERACTIVE)
+    http_pause_background(TRUE);
+  if (application_info.replay_dir && *application_info.replay_dir) {
+    http_replay_start(req);
+    return;
+  }
+  g_hash_table_insert(http_active, req->curl, req);
+  curl_multi_add_handle(http_multi, req->curl);
+}
 
-  if (!strncmp(url, "file:///", 8) || g_file_test(url, G_FILE_TEST_EXISTS)) {
-    gchar* newurl = g_filename_from_uri(url, NULL, NULL);
-    pixbuf = gdk_pixbuf_new_from_file(newurl ? newurl : url, &_error);
-  } else {
-    CURL* curl = NULL;
-    MEMFILE* mbody;
-    MEMFILE* mhead;
-    char* head;
-    char* body;
-    unsigned long size;
-    CURLcode res = CURLE_FAILED_INIT;
+static void
+http_request_stopped(HTTP_REQUEST* req) {
+  req->running = FALSE;
+  req->paused = FALSE;
+  if (--http_running[req->priority] == 0 &&
+          req->priority == HTTP_PRIORITY_INTERACTIVE)
+    http_pause_background(FALSE);
+}
 
-    curl = curl_easy_init();
-    if (!curl) return NULL;
-
-    mbody = memfopen();
-    mhead = memfopen();
-
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, REQUEST_TIMEOUT);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, memfwrite);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, mbody);
-    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, memfwrite);
-    curl_easy_setopt(curl, CURLOPT_HEADERDATA, mhead);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-    res = curl_easy_perform(curl);
-    curl_easy_cleanup(curl);
-
-    head = memfstrdup(mhead);
-    memfclose(mhead);
-    body = memfstrdup(mbody);
-    size = mbody->size;
-    memfclose(mbody);
-
-    if (res == CURLE_OK) {
-      char* ctype;
-      char* csize;
-      ctype = get_http_header_alloc(head, "Content-Type");
-      csize = get_http_header_alloc(head, "Content-Length");
+/* start waiting requests, most urgent first, as slots allow */
+static void
+http_schedule() {
+  int priority;
+
+  for (priority = 0; priority < HTTP_PRIORITY_COUNT; priority++) {
+    HTTP_REQUEST* req;
+    while ((req = (HTTP_REQUEST*) g_queue_peek_head(http_waiting[priority]))) {
+      int running = http_running[HTTP_PRIORITY_FOREGROUND]
+          + http_running[HTTP_PRIORITY_BACKGROUND];
+      if (priority != HTTP_PRIORITY_INTERACTIVE && running >= HTTP_MAX_TRANSFERS)
+        return;
+      if (priority == HTTP_PRIORITY_BACKGROUND &&
+              (http_running[HTTP_PRIORITY_INTERACTIVE] > 0 ||
+               http_running[HTTP_PRIORITY_BACKGROUND] >= HTTP_MAX_BACKGROUND))
+        return;
+      g_queue_pop_head(http_waiting[priority]);
+      if (g_atomic_int_get(&req->cancelled) && !req->followers) {
+        g_strlcpy(req->error, "cancelled", sizeof(req->error));
+        http_request_complete(req, CURLE_ABORTED_BY_CALLBACK);
+        continue;
+      }
+      http_request_start(req);
+    }
+  }
+}
 
-#ifdef _WIN32
-      if (ctype &&
-              (!strcmp(ctype, "image/jpeg") || !strcmp(ctype, "image/gif"))) {
-        char temp_path[MAX_PATH];
-        char temp_filename[MAX_PATH];
-        FILE* fp;
-        GetTempPath(sizeof(temp_path), temp_path);
-        GetTempFileName(temp_path, "gtktweeter-", 0, temp_filename);
-        fp = fopen(temp_filename, "wb");
-        if (fp) {
-          fwrite(body, size, 1, fp);
-          fclose(fp);
-        }
-        pixbuf = gdk_pixbuf_new_from_file(temp_filename, NULL);
-        DeleteFile(temp_filename);
-      } else
-#endif
-      {
-        if (ctype)
-          loader =
-              (GdkPixbufLoader*) gdk_pixbuf_loader_new_with_mime_type(ctype,
-                      error);
-        if (csize)
-          size = atol(csize);
-        if (!loader) loader = gdk_pixbuf_loader_new();
-        if (body && gdk_pixbuf_loader_write(loader, (const guchar*) body,
-                    size, &_error)) {
-          pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+static gboolean
+http_dispatch_event(gpointer data) {
+  HTTP_REQUEST* req;
+  while ((req = (HTTP_REQUEST*) g_async_queue_try_pop(http_incoming))) {
+    /* identical GETs already in flight share one transfer */
+    if (!strcmp(req->method, "GET") && !req->stream && !req->endless) {
+      HTTP_REQUEST* leader;
+      if (!req->key)
+        req->key = get_request_key_alloc(req->method, req->url, NULL);
+      leader = (HTTP_REQUEST*) g_hash_table_lookup(http_pending, req->key);
+      if (leader && !g_atomic_int_get(&leader->cancelled)) {
+        leader->followers = g_slist_prepend(leader->followers, req);
+        /* a waiting leader is promoted to the most urgent of its followers */
+        if (!leader->running && req->priority < leader->priority) {
+          g_queue_remove(http_waiting[leader->priority], leader);
+          leader->priority = req->priority;
+          g_queue_push_tail(http_waiting[leader->priority], leader);
         }
+        continue;
       }
-      if (ctype) free(ctype);
-      if (csize) free(csize);
-      if (loader) gdk_pixbuf_loader_close(loader, NULL);
-    } else {
-      _error = g_error_new_literal(G_FILE_ERROR, res,
-              curl_easy_strerror(res));
+      /* replace, so the key of a cancelled leader freed later isn't kept */
+      g_hash_table_replace(http_pending, req->key, req);
     }
-
-    free(head);
-    free(body);
+    g_queue_push_tail(http_waiting[req->priority], req);
   }
-
-  /* cleanup callback data */
-  if (error && _error) *error = _error;
-  return pixbuf;
+  http_schedule();
+  return FALSE;
 }
 
-/**
- * processing message funcs
- */
-static gpointer
-process_thread(gpointer data) {
-  PROCESS_THREAD_INFO* info = (PROCESS_THREAD_INFO*) data;
+static void
+http_engine_init() {
+  int priority;
+
+  http_main_thread = g_thread_self();
+  for (priority = 0; priority < HTTP_PRIORITY_COUNT; priority++)
+    http_waiting[priority] = g_queue_new();
+  http_incoming = g_async_queue_new();
+  http_active = g_hash_table_new(g_direct_hash, g_direct_equal);
+  http_pending = g_hash_table_new(g_str_hash, g_str_equal);
+  http_stats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  http_condition_load();
+  http_mutex = g_mutex_new();
+  http_cond = g_cond_new();
+  http_multi = curl_multi_init();
+  curl_multi_setopt(http_multi, CURLMOPT_SOCKETFUNCTION, http_socket_func);
+  curl_multi_setopt(http_multi, CURLMOPT_TIMERFUNCTION, http_timer_func);
+  curl_multi_setopt(http_multi, CURLMOPT_MAXCONNECTS, (long) CONNECTION_CACHE_SIZE);
+}
 
-  info->retval = info->func(info->data);
-  info->processing = FALSE;
+static void
+http_engine_cleanup() {
+  if (http_timer) g_source_remove(http_timer);
+  http_timer = 0;
+  curl_multi_cleanup(http_multi);
+  http_multi = NULL;
+  if (http_log) fclose(http_log);
+  http_log = NULL;
+  http_condition_save();
+}
 
-  return info->retval;
+/* headers go to req->head, Content-Length preallocates the body */
+static size_t
+http_header_func(char* ptr, size_t size, size_t nmemb, void* stream) {
+  HTTP_REQUEST* req = (HTTP_REQUEST*) stream;
+  size_t block = size * nmemb;
+
+  /* status of the latest response, known before the body arrives */
+  if (block > 9 && !strncmp(ptr, "HTTP/", 5)) {
+    const char* top = memchr(ptr, ' ', block);
+    if (top) req->http_status = strtol(top + 1, NULL, 10);
+  }
+  http_header_budget(req, ptr, block);
+  if (block > 15 && !strncasecmp(ptr, "Content-Length:", 15)) {
+    size_t length = (size_t) strtoul(ptr + 15, NULL, 10);
+    if (length > 0 && length <= MEMFILE_MAX_RESERVE)
+      memfreserve(req->body, req->body->size + length);
+  }
+  return memfwrite(ptr, size, nmemb, req->head);
 }
 
-static gpointer
-process_func(
-        GThreadFunc func, gpointer data,
-        GtkWidget* parent, const gchar* message) {
-  GtkWidget* loading_image = NULL;
-  GtkWidget* loading_label = NULL;
-  PROCESS_THREAD_INFO info;
-  GError* error = NULL;
-  GThread* thread = NULL;
+/* body goes to req->write_func, and to req->record when recording */
+static size_t
+http_write_func(char* ptr, size_t size, size_t nmemb, void* stream) {
+  HTTP_REQUEST* req = (HTTP_REQUEST*) stream;
+  if (req->record) memfwrite(ptr, size, nmemb, req->record);
+  return req->write_func(ptr, size, nmemb, req->write_data);
+}
 
-  if (parent) {
-    parent = gtk_widget_get_toplevel(parent);
-    loading_image = (GtkWidget*) g_object_get_data(G_OBJECT(parent),
-            "loading-image");
-    if (loading_image) gtk_widget_show(loading_image);
+/* aborts a cancelled transfer, unless others are attached to it */
+#if LIBCURL_VERSION_NUM >= 0x072000
+static int
+http_progress_func(void* data, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
+#else
+static int
+http_progress_func(void* data, double dltotal, double dlnow, double ultotal, double ulnow) {
+#endif
+  HTTP_REQUEST* req = (HTTP_REQUEST*) data;
+  return g_atomic_int_get(&req->cancelled) && !req->followers;
+}
 
-    if (message) {
-      loading_label = (GtkWidget*) g_object_get_data(G_OBJECT(parent),
-              "loading-label");
-      gtk_label_set_text(GTK_LABEL(loading_label), message);
-      gtk_widget_show(loading_label);
-    }
+/* endpoint names the request in statistics, NULL means the host of url */
+static HTTP_REQUEST*
+http_request_new(const char* endpoint, const char* url) {
+  HTTP_REQUEST* req = (HTTP_REQUEST*) g_malloc0(sizeof(HTTP_REQUEST));
+  req->endpoint = endpoint;
+  req->curl = curl_handle_new(url);
+  if (!req->curl) {
+    g_free(req);
+    return NULL;
   }
+  req->url = g_strdup(url);
+  req->method = "GET";
+  req->priority = HTTP_PRIORITY_FOREGROUND;
+  req->head = memfopen();
+  req->body = memfopen();
+  if (application_info.record_dir && *application_info.record_dir)
+    req->record = memfopen();
+  req->write_func = (curl_write_callback) memfwrite;
+  req->write_data = req->body;
+  curl_easy_setopt(req->curl, CURLOPT_SSL_VERIFYPEER, 0);
+  curl_easy_setopt(req->curl, CURLOPT_ERRORBUFFER, req->error);
+  curl_easy_setopt(req->curl, CURLOPT_URL, url);
+  curl_easy_setopt(req->curl, CURLOPT_CONNECTTIMEOUT, REQUEST_TIMEOUT);
+  curl_easy_setopt(req->curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
+  curl_easy_setopt(req->curl, CURLOPT_WRITEFUNCTION, http_write_func);
+  curl_easy_setopt(req->curl, CURLOPT_WRITEDATA, req);
+  curl_easy_setopt(req->curl, CURLOPT_HEADERFUNCTION, http_header_func);
+  curl_easy_setopt(req->curl, CURLOPT_HEADERDATA, req);
+  curl_easy_setopt(req->curl, CURLOPT_FOLLOWLOCATION, 1);
+  curl_easy_setopt(req->curl, CURLOPT_NOSIGNAL, 1);
+#if LIBCURL_VERSION_NUM >= 0x072000
+  curl_easy_setopt(req->curl, CURLOPT_XFERINFOFUNCTION, http_progress_func);
+  curl_easy_setopt(req->curl, CURLOPT_XFERINFODATA, req);
+#else
+  curl_easy_setopt(req->curl, CURLOPT_PROGRESSFUNCTION, http_progress_func);
+  curl_easy_setopt(req->curl, CURLOPT_PROGRESSDATA, req);
+#endif
+  curl_easy_setopt(req->curl, CURLOPT_NOPROGRESS, 0);
+  /* empty string offers every encoding libcurl was built with */
+  curl_easy_setopt(req->curl, CURLOPT_ACCEPT_ENCODING, "");
+  return req;
+}
 
-  if (parent) gdk_window_set_cursor(parent->window, watch_cursor);
-  gdk_flush();
+static void
+http_request_add_header(HTTP_REQUEST* req, const char* header) {
+  req->headers = curl_slist_append(req->headers, header);
+  curl_easy_setopt(req->curl, CURLOPT_HTTPHEADER, req->headers);
+}
 
-  gdk_threads_leave();
+/* postfields must stay alive until the request is finished */
+static void
+http_request_set_post(HTTP_REQUEST* req, const char* postfields) {
+  req->method = "POST";
+  req->postfields = postfields;
+  /* posts are what the user is waiting for */
+  req->priority = HTTP_PRIORITY_INTERACTIVE;
+  curl_easy_setopt(req->curl, CURLOPT_POST, 1);
+  curl_easy_setopt(req->curl, CURLOPT_POSTFIELDS, postfields);
+  /* send the body right away instead of waiting for 100-continue */
+  http_request_add_header(req, "Expect:");
+}
 
-  info.func = func;
-  info.data = data;
-  info.retval = NULL;
-  info.processing = TRUE;
-  thread = g_thread_create(
-          process_thread,
-          &info,
-          TRUE,
-          &error);
-  if (error) g_error_free(error);
-  while(info.processing) {
-    gdk_threads_enter();
-    gtk_main_iteration_do(TRUE);
-    gdk_threads_leave();
-    g_thread_yield();
+static void
+http_request_free(HTTP_REQUEST* req) {
+  if (!req) return;
+  curl_handle_free(req->curl);
+  if (req->headers) curl_slist_free_all(req->headers);
+  g_free(req->url);
+  g_free(req->key);
+  g_free(req->postdata);
+  memfclose(req->head);
+  memfclose(req->body);
+  if (req->record) memfclose(req->record);
+  if (req->replay) http_replay_free(req->replay);
+  if (req->stream) json_stream_free(req->stream);
+  if (req->values) {
+    gpointer value;
+    while ((value = g_async_queue_try_pop(req->values)))
+      if (value != req) json_value_free((JSON_Value*) value);
+    g_async_queue_unref(req->values);
   }
-  g_thread_join(thread);
+  g_free(req);
+}
 
-  gdk_threads_enter();
-  if (loading_image) gtk_widget_hide(loading_image);
-  if (loading_label) gtk_widget_hide(loading_label);
+/* may be called from any thread, func is called on the main loop */
+static void
+http_request_submit(HTTP_REQUEST* req, HTTP_REQUEST_FUNC func, gpointer user_data) {
+  req->func = func;
+  req->user_data = user_data;
+  req->done = FALSE;
+  req->res = CURLE_FAILED_INIT;
+  req->http_status = 0;
+  memset(&req->budget, 0, sizeof(req->budget));
+  g_async_queue_push(http_incoming, req);
+  g_idle_add(http_dispatch_event, NULL);
+}
 
-  if (parent) gdk_window_set_cursor(parent->window, NULL);
-  return info.retval;
+/* may be called from any thread while req is alive, a waiting req is
+ * dropped and a running one aborted, both complete with
+ * CURLE_ABORTED_BY_CALLBACK */
+static void
+http_request_cancel(HTTP_REQUEST* req) {
+  g_atomic_int_set(&req->cancelled, TRUE);
+}
+
+static void
+http_request_wakeup(HTTP_REQUEST* req, gpointer user_data) {
+  g_mutex_lock(http_mutex);
+  req->done = TRUE;
+  if (user_data) g_main_loop_quit((GMainLoop*) user_data);
+  g_cond_broadcast(http_cond);
+  g_mutex_unlock(http_mutex);
 }
 
 /**
- * dialog message func
+ * streaming json body
+ *
+ * elements of a top level array are parsed while the body arrives and are
+ * queued for a worker thread, which takes them with http_request_next_value.
  */
 static void
-error_dialog(GtkWidget* widget, const char* message) {
-  GtkWidget* dialog;
-  dialog = gtk_message_dialog_new(
-          GTK_WINDOW(gtk_widget_get_toplevel(widget)),
-          (GtkDialogFlags)(GTK_DIALOG_MODAL),
-          GTK_MESSAGE_WARNING,
-          GTK_BUTTONS_CLOSE,
-          message, NULL);
-  gtk_window_set_title(GTK_WINDOW(dialog), APP_TITLE);
-  gtk_widget_show(dialog);
-  gtk_window_set_modal(GTK_WINDOW(dialog), TRUE);
-  gtk_window_set_position(GTK_WINDOW(dialog), GTK_WIN_POS_CENTER_ON_PARENT);
-  gtk_window_set_transient_for(
-          GTK_WINDOW(dialog),
-          GTK_WINDOW(gtk_widget_get_toplevel(widget)));
-  gtk_dialog_run(GTK_DIALOG(dialog));
-  gtk_widget_destroy(dialog);
+http_stream_value(JSON_Value* value, void* user_data) {
+  HTTP_REQUEST* req = (HTTP_REQUEST*) user_data;
+  g_async_queue_push(req->values, value);
+}
+
+static size_t
+http_stream_write(char* ptr, size_t size, size_t nmemb, void* stream) {
+  HTTP_REQUEST* req = (HTTP_REQUEST*) stream;
+
+  /* anything but a successful response is kept as text */
+  if (req->http_status != 200)
+    return memfwrite(ptr, size, nmemb, req->body);
+  req->streamed += size * nmemb;
+  json_stream_feed(req->stream, ptr, size * nmemb);
+  return size * nmemb;
 }
 
 static void
-insert_status_text(GtkTextBuffer* buffer, GtkTextIter* iter, const char* status) {
-  char* ptr = (char*) status;
-  char* last = ptr;
-  if (!status) return;
-  while(*ptr) {
-    if (!strncmp(ptr, "http://", 7) || !strncmp(ptr, "ftp://", 6)) {
-      GtkTextTag* tag;
-      int len;
-      char* link;
-      char* tmp;
-      gchar* url;
+http_stream_done(HTTP_REQUEST* req, gpointer user_data) {
+  /* request itself marks the end of values */
+  g_async_queue_push(req->values, req);
+}
 
-      if (last != ptr)
-        gtk_text_buffer_insert(buffer, iter, last, ptr-last);
+static void
+http_request_stream_json(HTTP_REQUEST* req) {
+  req->stream = json_stream_new(http_stream_value, req);
+  req->values = g_async_queue_new();
+  req->write_func = http_stream_write;
+  req->write_data = req;
+  /* streamed body is not kept, but the conditional cache needs it */
+  if (req->conditional && !req->record) req->record = memfopen();
+  http_request_submit(req, http_stream_done, NULL);
+}
 
-      tmp = ptr;
-      while(*tmp && strchr(ACCEPT_LETTER_URL, *tmp)) tmp++;
-      len = (int)(tmp-ptr);
-      link = malloc(len+1);
-      memset(link, 0, len+1);
-      strncpy(link, ptr, len);
-      tag = gtk_text_buffer_create_tag(
-              buffer,
-              NULL,
-              "foreground",
-              "blue",
-              "underline",
-              PANGO_UNDERLINE_SINGLE,
-              NULL);
-      url = g_strdup(link);
-      g_object_set_data(G_OBJECT(tag), "url", (gpointer) url);
-      gtk_text_buffer_insert_with_tags(buffer, iter, link, -1, tag, NULL);
-      free(link);
-      ptr = last = tmp;
-    } else
-      if (*ptr == '@' || !strncmp(ptr, "\xef\xbc\xa0", 3)) {
-        GtkTextTag* tag;
-        int len;
-        char* link;
-        char* tmp;
-        gchar* url;
-        gchar* user_id;
-        gchar* user_name;
+/* one value per line, for long-lived streams which never finish a document */
+static size_t
+http_lines_write(char* ptr, size_t size, size_t nmemb, void* stream) {
+  HTTP_REQUEST* req = (HTTP_REQUEST*) stream;
+  MEMFILE* mf = req->body;
+  size_t block = size * nmemb;
+  char* line;
+  char* eol;
+
+  if (memfwrite(ptr, size, nmemb, mf) != block) return 0;
+  if (req->http_status != 200) return block;
+  req->streamed += block;
+  line = mf->data;
+  while ((eol = memchr(line, '\n', mf->size - (line - mf->data)))) {
+    /* blank lines are keep-alives */
+    JSON_Value* value = json_parse_nstring(line, eol - line);
+    if (value) g_async_queue_push(req->values, value);
+    line = eol + 1;
+  }
+  /* incomplete line waits for the next chunk */
+  mf->size -= line - mf->data;
+  memmove(mf->data, line, mf->size);
+  mf->data[mf->size] = 0;
+  return block;
+}
 
-        if (last != ptr)
-          gtk_text_buffer_insert(buffer, iter, last, ptr-last);
+static void
+http_request_stream_lines(HTTP_REQUEST* req) {
+  req->values = g_async_queue_new();
+  req->write_func = http_lines_write;
+  req->write_data = req;
+  req->endless = TRUE;
+  /* there is no end to record */
+  if (req->record) {
+    memfclose(req->record);
+    req->record = NULL;
+  }
+  curl_easy_setopt(req->curl, CURLOPT_TIMEOUT, 0L);
+  /* keep-alive lines come every 30 seconds, silence means a stalled stream */
+  curl_easy_setopt(req->curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+  curl_easy_setopt(req->curl, CURLOPT_LOW_SPEED_TIME, (long) STREAM_STALL_TIME);
+  http_request_submit(req, http_stream_done, NULL);
+}
 
-        user_name = tmp = ptr + (*ptr == '@' ? 1 : 3);
+/* blocks until next element is parsed, NULL when the transfer finished */
+static JSON_Value*
+http_request_next_value(HTTP_REQUEST* req) {
+  gpointer value = g_async_queue_pop(req->values);
+  return value == req ? NULL : (JSON_Value*) value;
+}
+
+/**
+ * wait for the request. worker threads sleep on the condition, the main
+ * thread (which must hold the gdk lock) spins a nested main loop instead.
+ */
+static CURLcode
+http_request_perform(HTTP_REQUEST* req) {
+  if (!req) return CURLE_FAILED_INIT;
+  if (g_thread_self() == http_main_thread) {
+    GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+    http_request_submit(req, http_request_wakeup, loop);
+    gdk_threads_leave();
+    g_main_loop_run(loop);
+    gdk_threads_enter();
+    g_main_loop_unref(loop);
+  } else {
+    g_mutex_lock(http_mutex);
+    http_request_submit(req, http_request_wakeup, NULL);
+    while (!req->done)
+      g_cond_wait(http_cond, http_mutex);
+    g_mutex_unlock(http_mutex);
+  }
+  return req->res;
+}
+
+/**
+ * timer register
+ */
+static guint
+reload_timer_func(gpointer data) {
+  GtkWidget* window = (GtkWidget*) data;
+  gchar* mode = g_object_get_data(G_OBJECT(window), "mode");
+  gchar* first_id = g_object_get_data(G_OBJECT(window), "first_status_id");
+  gboolean search = mode && !strcmp(mode, "search");
+  gchar* old_data;
+
+  /* no budget left for a poll or the stream delivers it, try again later */
+  if (!rate_budget_allows(http_last_refresh_endpoint, TRUE) ||
+          timeline_stream_skip_poll(window)) {
+    start_reload_timer(window);
+    return 0;
+  }
+
+  if (first_id && !search) {
+    /* only ask for statuses newer than the top of the timeline */
+    old_data = g_object_get_data(G_OBJECT(window), "since_id");
+    if (old_data) g_free(old_data);
+    g_object_set_data(G_OBJECT(window), "since_id", g_strdup(first_id));
+  } else {
+    old_data = g_object_get_data(G_OBJECT(window), "last_status_id");
+    if (old_data) g_free(old_data);
+    g_object_set_data(G_OBJECT(window), "last_status_id", NULL);
+  }
+
+  gdk_threads_enter();
+  /* gaps left by budget shortage are retried with each poll */
+  timeline_backfill(window);
+  if (search)
+    search_timeline(window, NULL);
+  else
+    update_timeline(window, NULL);
+  gdk_threads_leave();
+  return 0;
+}
+
+/* statuses asked for by one poll, more when polls are further apart */
+static int
+get_poll_count(const char* endpoint) {
+  guint interval = rate_budget_interval(endpoint, RELOAD_TIMER_SPAN);
+  int count = POLL_COUNT * (int) (interval / RELOAD_TIMER_SPAN);
+  return count < POLL_COUNT_MAX ? count : POLL_COUNT_MAX;
+}
+
+static void
+stop_reload_timer(GtkWidget* window) {
+  if (reload_timer != 0) {
+    g_source_remove(reload_timer);
+    reload_timer = 0;
+  }
+}
+
+static void
+start_reload_timer(GtkWidget* window) {
+  stop_reload_timer(window);
+  reload_timer = g_timeout_add_full(
+          G_PRIORITY_LOW,
+          rate_budget_interval(http_last_refresh_endpoint, RELOAD_TIMER_SPAN),
+          (GSourceFunc) reload_timer_func,
+          window,
+          NULL);
+}
+
+static void
+reset_reload_timer(GtkWidget* window) {
+  stop_reload_timer(window);
+  start_reload_timer(window);
+}
+
+/* value of header key in the head ptr, which may be NULL when empty */
+static char*
+get_http_header_alloc(const char* ptr, const char* key) {
+  const char* tmp = ptr;
+
+  if (!ptr) return NULL;
+  while (*ptr) {
+    tmp = strpbrk(ptr, "\r\n");
+    if (!tmp) break;
+    if (!strncasecmp(ptr, key, strlen(key)) && *(ptr + strlen(key)) == ':') {
+      size_t len;
+      char* val;
+      const char* top = ptr + strlen(key) + 1;
+      while (*top && isspace(*top)) top++;
+      if (!*top) return NULL;
+      len = tmp - top + 1;
+      val = malloc(len);
+      memset(val, 0, len);
+      strncpy(val, top, len-1);
+      return val;
+    }
+    ptr = tmp + 1;
+  }
+  return NULL;
+}
+
+static char*
+get_short_url_alloc(const char* url) {
+  gchar* purl;
+  char* longurl;
+  HTTP_REQUEST* req;
+  char* ret = NULL;
+
+  longurl = urlencode_alloc(url);
+  if (!longurl) return NULL;
+  purl = g_strdup_printf(SHORTURL_API_URL, longurl);
+  free(longurl);
+
+  req = http_request_new(SHORTURL_API_URL, purl);
+  /* part of a post, so it must not wait behind a refresh either */
+  if (req) req->priority = HTTP_PRIORITY_INTERACTIVE;
+  if (http_request_perform(req) == CURLE_OK)
+    ret = memfdetach(req->body);
+  http_request_free(req);
+
+  g_free(purl);
+
+  return ret;
+}
+
+static char*
+get_short_status_alloc(const char* status) {
+  const char* ptr = status;
+  const char* last = ptr;
+  char* ret = NULL;
+  int len = 0;
+  while(*ptr) {
+    if (!strncmp(ptr, "http://", 7) || !strncmp(ptr, "ftp://", 6)) {
+      char* link;
+      char* short_url;
+      const char* tmp;
+
+      if (last != ptr) {
+        len += (ptr-last);
+        if (!ret) {
+          ret = malloc(len+1);
+          memset(ret, 0, len+1);
+        } else ret = realloc(ret, len+1);
+        strncat(ret, last, ptr-last);
+      }
+
+      tmp = ptr;
+      while(*tmp && strchr(ACCEPT_LETTER_URL, *tmp)) tmp++;
+      link = malloc(tmp-ptr+1);
+      memset(link, 0, tmp-ptr+1);
+      memcpy(link, ptr, tmp-ptr);
+      short_url = get_short_url_alloc(link);
+      if (short_url) {
+        free(link);
+        link = short_url;
+      }
+
+      len += strlen(link);
+      if (!ret) {
+        ret = malloc(len+1);
+        memset(ret, 0, len+1);
+      } else ret = realloc(ret, len+1);
+      strcat(ret, link);
+      free(link);
+      ptr = last = tmp;
+    } else
+      ptr++;
+  }
+  if (last != ptr) {
+    len += (ptr-last);
+    if (!ret) {
+      ret = malloc(len+1);
+      memset(ret, 0, len+1);
+    } else ret = realloc(ret, len+1);
+    strncat(ret, last, ptr-last);
+  }
+  return ret;
+}
+
+/**
+ * oAuth
+ *
+ * every request is signed by oauth_sign_with_alloc. parameters are
+ * percent encoded and sorted by name and value as the spec wants, the
+ * signature base string is written into a single buffer sized up front,
+ * and the HMAC-SHA1 key state of the last credentials is kept, so a
+ * signature costs two sha1 runs over the base string and nothing more.
+ * nonce, timestamp and signature travel in the Authorization header, which
+ * leaves the same url for the same question, for the conditional cache and
+ * coalescing of the http engine.
+ */
+typedef struct _OAUTH_PARAM {
+  const char* name;
+  const char* value; /* not encoded, NULL leaves the parameter out */
+} OAUTH_PARAM;
+
+/* name and value percent encoded once, as they are sent */
+typedef struct _OAUTH_ENCODED {
+  char* name;
+  char* value;
+} OAUTH_ENCODED;
+
+/* signing key "consumer_secret&token_secret" of oauth_key */
+static gchar* oauth_secret = NULL;
+static hmac_key oauth_key;
+static GStaticMutex oauth_key_mutex = G_STATIC_MUTEX_INIT;
+
+static int
+oauth_compare_param(const void* a, const void* b) {
+  const OAUTH_ENCODED* x = (const OAUTH_ENCODED*) a;
+  const OAUTH_ENCODED* y = (const OAUTH_ENCODED*) b;
+  int r = strcmp(x->name, y->name);
+  return r ? r : strcmp(x->value, y->value);
+}
+
+/* key state for the credentials, derived again only when they changed */
+static void
+oauth_get_key(const char* consumer_secret, const char* token_secret, hmac_key* key) {
+  size_t len = strlen(consumer_secret);
+
+  g_static_mutex_lock(&oauth_key_mutex);
+  if (!oauth_secret || strncmp(oauth_secret, consumer_secret, len) ||
+          oauth_secret[len] != '&' || strcmp(oauth_secret + len + 1, token_secret)) {
+    g_free(oauth_secret);
+    oauth_secret = g_strdup_printf("%s&%s", consumer_secret, token_secret);
+    hmac_key_init(&oauth_key, (unsigned char*) oauth_secret, strlen(oauth_secret));
+  }
+  *key = oauth_key;
+  g_static_mutex_unlock(&oauth_key_mutex);
+}
+
+/* "Authorization: OAuth ..." header with the oauth parameters and the
+ * signature for method, url, which has no query, and params. *query gets
+ * the other params, encoded and sorted, for the query string or the body.
+ * token may be NULL before authorization */
+static gchar*
+oauth_sign_with_alloc(const char* method, const char* url,
+        const char* consumer_key, const char* consumer_secret,
+        const char* token, const char* token_secret,
+        const OAUTH_PARAM* params, int count, gchar** query) {
+  OAUTH_PARAM oauth[6];
+  OAUTH_ENCODED* encoded;
+  hmac_key key;
+  char timestamp[16];
+  unsigned char digest[20];
+  char signature[BASE64_SIZE(20) + 1];
+  char* nonce;
+  char* names;
+  char* base;
+  char* signed_params;
+  char* header;
+  char* ptr;
+  char* qptr;
+  char* hptr;
+  size_t size = 0;
+  size_t url_len = strlen(url);
+  int total = 0;
+  int n, m;
+
+  nonce = get_nonce_alloc();
+  snprintf(timestamp, sizeof(timestamp), "%d", (int) time(0));
+  oauth[0].name = "oauth_consumer_key";     oauth[0].value = consumer_key;
+  oauth[1].name = "oauth_nonce";            oauth[1].value = nonce;
+  oauth[2].name = "oauth_signature_method"; oauth[2].value = "HMAC-SHA1";
+  oauth[3].name = "oauth_timestamp";        oauth[3].value = timestamp;
+  oauth[4].name = "oauth_token";            oauth[4].value = token;
+  oauth[5].name = "oauth_version";          oauth[5].value = "1.0";
+
+  /* encoded once into a single block */
+  for (n = 0; n < count + 6; n++) {
+    const OAUTH_PARAM* param = n < count ? &params[n] : &oauth[n - count];
+    if (!param->value) continue;
+    size += urlencode_size(param->name, strlen(param->name)) +
+        urlencode_size(param->value, strlen(param->value)) + 2;
+    total++;
+  }
+  encoded = (OAUTH_ENCODED*) g_malloc(sizeof(OAUTH_ENCODED) * total);
+  ptr = names = (char*) g_malloc(size + 1);
+  for (n = m = 0; n < count + 6; n++) {
+    const OAUTH_PARAM* param = n < count ? &params[n] : &oauth[n - count];
+    if (!param->value) continue;
+    encoded[m].name = ptr;
+    ptr = urlencode(ptr, param->name, strlen(param->name)) + 1;
+    encoded[m].value = ptr;
+    ptr = urlencode(ptr, param->value, strlen(param->value)) + 1;
+    m++;
+  }
+  free(nonce);
+  qsort(encoded, total, sizeof(OAUTH_ENCODED), oauth_compare_param);
+
+  /* all of name=value&... is signed. oauth_* ones go to the header as
+   * name="value", with room for the signature, the rest to the query */
+  signed_params = (char*) g_malloc(size + 1);
+  *query = (char*) g_malloc(size + 1);
+  header = (char*) g_malloc(sizeof("Authorization: OAuth ") + size + total * 3 +
+          sizeof("oauth_signature=\"\"") + BASE64_SIZE(20) * 3);
+  ptr = signed_params;
+  qptr = *query;
+  hptr = g_stpcpy(header, "Authorization: OAuth ");
+  for (n = 0; n < total; n++) {
+    if (n) *ptr++ = '&';
+    ptr = g_stpcpy(ptr, encoded[n].name);
+    *ptr++ = '=';
+    ptr = g_stpcpy(ptr, encoded[n].value);
+    if (!strncmp(encoded[n].name, "oauth_", 6)) {
+      hptr = g_stpcpy(hptr, encoded[n].name);
+      hptr = g_stpcpy(hptr, "=\"");
+      hptr = g_stpcpy(hptr, encoded[n].value);
+      hptr = g_stpcpy(hptr, "\", ");
+    } else {
+      if (qptr != *query) *qptr++ = '&';
+      qptr = g_stpcpy(qptr, encoded[n].name);
+      *qptr++ = '=';
+      qptr = g_stpcpy(qptr, encoded[n].value);
+    }
+  }
+  *ptr = 0;
+  *qptr = 0;
+  size = ptr - signed_params;
+  g_free(encoded);
+  g_free(names);
+
+  /* method&url&params, both encoded once more */
+  base = (char*) g_malloc(strlen(method) +
+          urlencode_size(url, url_len) + urlencode_size(signed_params, size) + 3);
+  ptr = g_stpcpy(base, method);
+  *ptr++ = '&';
+  ptr = urlencode(ptr, url, url_len);
+  *ptr++ = '&';
+  ptr = urlencode(ptr, signed_params, size);
+  g_free(signed_params);
+
+  oauth_get_key(consumer_secret, token_secret ? token_secret : "", &key);
+  hmac_key_sign(&key, (unsigned char*) base, ptr - base, digest);
+  g_free(base);
+
+  base64encode(signature, digest, sizeof(digest));
+  hptr = g_stpcpy(hptr, "oauth_signature=\"");
+  hptr = urlencode(hptr, signature, strlen(signature));
+  g_stpcpy(hptr, "\"");
+  return header;
+}
+
+/* request of method, GET or POST, for url signed in its Authorization
+ * header. params go to the query string of a GET and the body of a POST,
+ * so the url of a GET only changes with what it asks for */
+static HTTP_REQUEST*
+oauth_request_with_new(const char* endpoint, const char* method, const char* url,
+        const char* consumer_key, const char* consumer_secret,
+        const char* token, const char* token_secret,
+        const OAUTH_PARAM* params, int count) {
+  HTTP_REQUEST* req;
+  gchar* header;
+  gchar* query;
+  gchar* purl = NULL;
+
+  header = oauth_sign_with_alloc(method, url, consumer_key, consumer_secret,
+          token, token_secret, params, count, &query);
+  if (!strcmp(method, "GET") && *query)
+    purl = g_strdup_printf("%s?%s", url, query);
+  req = http_request_new(endpoint, purl ? purl : url);
+  g_free(purl);
+  if (req) {
+    http_request_add_header(req, header);
+    if (strcmp(method, "GET")) {
+      req->postdata = query;
+      query = NULL;
+      http_request_set_post(req, req->postdata);
+    }
+  }
+  g_free(query);
+  g_free(header);
+  return req;
+}
+
+/* signed request as the authorized user */
+static HTTP_REQUEST*
+oauth_request_new(const char* endpoint, const char* method, const char* url,
+        const OAUTH_PARAM* params, int count) {
+  return oauth_request_with_new(endpoint, method, url,
+          application_info.consumer_key, application_info.consumer_secret,
+          application_info.access_token, application_info.access_token_secret,
+          params, count);
+}
+
+static char*
+get_request_token_alloc(
+        const char* consumer_key,
+        const char* consumer_secret) {
+
+  char* ptr = NULL;
+  char* url;
+  HTTP_REQUEST* req;
+  CURLcode res = CURLE_OK;
+
+  url = get_api_url_alloc(SERVICE_REQUEST_TOKEN_URL);
+  req = oauth_request_with_new(SERVICE_REQUEST_TOKEN_URL, "POST", url,
+          consumer_key, consumer_secret, NULL, NULL, NULL, 0);
+  g_free(url);
+  if (!req) return NULL;
+  res = http_request_perform(req);
+  if (res != CURLE_OK) {
+    fputs(req->error, stderr);
+    ptr = NULL;
+  } else {
+    ptr = memfdetach(req->body);
+  }
+  http_request_free(req);
+  return ptr;
+}
+
+static char*
+get_access_token_alloc(
+        const char* consumer_key,
+        const char* consumer_secret,
+        const char* request_token,
+        const char* request_token_secret,
+        const char* verifier) {
+
+  OAUTH_PARAM params[1];
+  char* ptr = NULL;
+  char* url;
+  HTTP_REQUEST* req;
+  CURLcode res = CURLE_OK;
+
+  url = get_api_url_alloc(SERVICE_ACCESS_TOKEN_URL);
+  /* oauth_* parameters are sent in the header with the signature */
+  params[0].name = "oauth_verifier";
+  params[0].value = verifier;
+  req = oauth_request_with_new(SERVICE_ACCESS_TOKEN_URL, "POST", url,
+          consumer_key, consumer_secret, request_token, request_token_secret, params, 1);
+  g_free(url);
+  if (!req) return NULL;
+  res = http_request_perform(req);
+  if (res != CURLE_OK) {
+    fputs(req->error, stderr);
+    ptr = NULL;
+  } else {
+    ptr = memfdetach(req->body);
+  }
+  http_request_free(req);
+  return ptr;
+}
+
+/**
+ * get pixbuf from response
+ */
+static GdkPixbuf*
+http_response_pixbuf(HTTP_REQUEST* req, GError** error) {
+  GdkPixbuf* pixbuf = NULL;
+  GdkPixbufLoader* loader = NULL;
+  const char* body = req->body->data;
+  unsigned long size = req->body->size;
+  char* ctype;
+
+  if (req->res != CURLE_OK) {
+    if (error)
+      *error = g_error_new_literal(G_FILE_ERROR, req->res,
+              curl_easy_strerror(req->res));
+    return NULL;
+  }
+  if (!body) return NULL;
+  ctype = get_http_header_alloc(req->head->data, "Content-Type");
+
+#ifdef _WIN32
+  if (ctype &&
+          (!strcmp(ctype, "image/jpeg") || !strcmp(ctype, "image/gif"))) {
+    char temp_path[MAX_PATH];
+    char temp_filename[MAX_PATH];
+    FILE* fp;
+    GetTempPath(sizeof(temp_path), temp_path);
+    GetTempFileName(temp_path, "gtktweeter-", 0, temp_filename);
+    fp = fopen(temp_filename, "wb");
+    if (fp) {
+      fwrite(body, size, 1, fp);
+      fclose(fp);
+    }
+    pixbuf = gdk_pixbuf_new_from_file(temp_filename, NULL);
+    DeleteFile(temp_filename);
+  } else
+#endif
+  {
+    gboolean ok;
+    if (ctype)
+      loader =
+          (GdkPixbufLoader*) gdk_pixbuf_loader_new_with_mime_type(ctype, NULL);
+    if (!loader) loader = gdk_pixbuf_loader_new();
+    ok = gdk_pixbuf_loader_write(loader, (const guchar*) body, size, error);
+    /* loader must be closed even if the write failed */
+    if (!gdk_pixbuf_loader_close(loader, ok ? error : NULL)) ok = FALSE;
+    if (ok) pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+    if (pixbuf) g_object_ref(pixbuf);
+    g_object_unref(loader);
+  }
+  if (ctype) free(ctype);
+  return pixbuf;
+}
+
+/**
+ * processing message funcs
+ */
+static gboolean
+process_thread_done(gpointer data) {
+  PROCESS_THREAD_INFO* info = (PROCESS_THREAD_INFO*) data;
+  g_main_loop_quit(info->loop);
+  return FALSE;
+}
+
+static gpointer
+process_thread(gpointer data) {
+  PROCESS_THREAD_INFO* info = (PROCESS_THREAD_INFO*) data;
+
+  info->retval = info->func(info->data);
+  g_idle_add(process_thread_done, info);
+
+  return info->retval;
+}
+
+static gpointer
+process_func(
+        GThreadFunc func, gpointer data,
+        GtkWidget* parent, const gchar* message) {
+  GtkWidget* loading_image = NULL;
+  GtkWidget* loading_label = NULL;
+  PROCESS_THREAD_INFO info;
+  GError* error = NULL;
+  GThread* thread = NULL;
+
+  if (parent) {
+    parent = gtk_widget_get_toplevel(parent);
+    loading_image = (GtkWidget*) g_object_get_data(G_OBJECT(parent),
+            "loading-image");
+    if (loading_image) gtk_widget_show(loading_image);
+
+    if (message) {
+      loading_label = (GtkWidget*) g_object_get_data(G_OBJECT(parent),
+              "loading-label");
+      gtk_label_set_text(GTK_LABEL(loading_label), message);
+      gtk_widget_show(loading_label);
+    }
+  }
+
+  if (parent) gdk_window_set_cursor(parent->window, watch_cursor);
+  gdk_flush();
+
+  gdk_threads_leave();
+
+  info.func = func;
+  info.data = data;
+  info.retval = NULL;
+  info.loop = g_main_loop_new(NULL, FALSE);
+  thread = g_thread_create(
+          process_thread,
+          &info,
+          TRUE,
+          &error);
+  if (error) g_error_free(error);
+  if (thread) {
+    /* main loop keeps serving events and transfers until thread is done */
+    g_main_loop_run(info.loop);
+    g_thread_join(thread);
+  }
+  g_main_loop_unref(info.loop);
+
+  gdk_threads_enter();
+  if (loading_image) gtk_widget_hide(loading_image);
+  if (loading_label) gtk_widget_hide(loading_label);
+
+  if (parent) gdk_window_set_cursor(parent->window, NULL);
+  return info.retval;
+}
+
+/**
+ * dialog message func
+ */
+static void
+error_dialog(GtkWidget* widget, const char* message) {
+  GtkWidget* dialog;
+  dialog = gtk_message_dialog_new(
+          GTK_WINDOW(gtk_widget_get_toplevel(widget)),
+          (GtkDialogFlags)(GTK_DIALOG_MODAL),
+          GTK_MESSAGE_WARNING,
+          GTK_BUTTONS_CLOSE,
+          message, NULL);
+  gtk_window_set_title(GTK_WINDOW(dialog), APP_TITLE);
+  gtk_widget_show(dialog);
+  gtk_window_set_modal(GTK_WINDOW(dialog), TRUE);
+  gtk_window_set_position(GTK_WINDOW(dialog), GTK_WIN_POS_CENTER_ON_PARENT);
+  gtk_window_set_transient_for(
+          GTK_WINDOW(dialog),
+          GTK_WINDOW(gtk_widget_get_toplevel(widget)));
+  gtk_dialog_run(GTK_DIALOG(dialog));
+  gtk_widget_destroy(dialog);
+}
+
+/* screen names of @mentions are added to mentions, unless it is NULL */
+static void
+insert_status_text(GtkTextBuffer* buffer, GtkTextIter* iter, const char* status, GHashTable* mentions) {
+  char* ptr = (char*) status;
+  char* last = ptr;
+  if (!status) return;
+  while(*ptr) {
+    if (!strncmp(ptr, "http://", 7) || !strncmp(ptr, "https://", 8) ||
+            !strncmp(ptr, "ftp://", 6)) {
+      GtkTextTag* tag;
+      int len;
+      char* link;
+      char* tmp;
+      gchar* url;
+
+      if (last != ptr)
+        gtk_text_buffer_insert(buffer, iter, last, ptr-last);
+
+      tmp = ptr;
+      while(*tmp && strchr(ACCEPT_LETTER_URL, *tmp)) tmp++;
+      len = (int)(tmp-ptr);
+      link = malloc(len+1);
+      memset(link, 0, len+1);
+      strncpy(link, ptr, len);
+      tag = gtk_text_buffer_create_tag(
+              buffer,
+              NULL,
+              "foreground",
+              "blue",
+              "underline",
+              PANGO_UNDERLINE_SINGLE,
+              NULL);
+      url = g_strdup(link);
+      g_object_set_data(G_OBJECT(tag), "url", (gpointer) url);
+      gtk_text_buffer_insert_with_tags(buffer, iter, link, -1, tag, NULL);
+      free(link);
+      ptr = last = tmp;
+    } else
+      if (*ptr == '@' || !strncmp(ptr, "\xef\xbc\xa0", 3)) {
+        GtkTextTag* tag;
+        int len;
+        char* link;
+        char* tmp;
+        gchar* url;
+        gchar* user_id;
+        gchar* user_name;
+
+        if (last != ptr)
+          gtk_text_buffer_insert(buffer, iter, last, ptr-last);
+
+        user_name = tmp = ptr + (*ptr == '@' ? 1 : 3);
         while(*tmp && strchr(ACCEPT_LETTER_USER, *tmp)) tmp++;
         len = (int)(tmp-user_name);
         if (len) {
@@ -1149,6 +2146,8 @@ insert_status_text(GtkTextBuffer* buffer, GtkTextIter* iter, const char* status)
           g_object_set_data(G_OBJECT(tag), "user_id", (gpointer) user_id);
           g_object_set_data(G_OBJECT(tag), "user_name", (gpointer) user_name);
           gtk_text_buffer_insert_with_tags(buffer, iter, url, -1, tag, NULL);
+          if (mentions)
+            g_hash_table_replace(mentions, g_strdup(user_name), GINT_TO_POINTER(TRUE));
           g_free(url);
           ptr = last = tmp;
         } else
@@ -1160,304 +2159,1657 @@ insert_status_text(GtkTextBuffer* buffer, GtkTextIter* iter, const char* status)
           char* link;
           char* tmp;
 
-          if (last != ptr)
-            gtk_text_buffer_insert(buffer, iter, last, ptr-last);
+          if (last != ptr)
+            gtk_text_buffer_insert(buffer, iter, last, ptr-last);
+
+          link = tmp = ptr + 1;
+          while(*tmp && strchr(ACCEPT_LETTER_TAG, *tmp)) tmp++;
+          len = (int)(tmp-link);
+          if (len) {
+            link = malloc(len+2);
+            memset(link, 0, len+2);
+            strncpy(link, ptr, len+1);
+            tag = gtk_text_buffer_create_tag(
+                    buffer,
+                    NULL,
+                    "foreground",
+                    "darkgreen",
+                    "underline",
+                    PANGO_UNDERLINE_SINGLE,
+                    NULL);
+            g_object_set_data(G_OBJECT(tag), "tag_name", (gpointer) link);
+            gtk_text_buffer_insert_with_tags(buffer, iter, link, -1, tag, NULL);
+            ptr = last = tmp;
+          } else
+            ptr = tmp;
+        }
+    ptr++;
+  }
+  if (last != ptr && strlen(last))
+    gtk_text_buffer_insert(buffer, iter, last, ptr-last);
+}
+
+static time_t
+tweettime_to_time(struct tm* tm, const char* s) {
+  int i;
+  struct tm tmptm;
+  time_t tmptime;
+
+  static char* wday[] = {
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat",
+    NULL
+  };
+  static char* mon[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+    NULL
+  };
+
+  memset(&tmptm, 0, sizeof(tmptm));
+  /* Sun */
+  for(i = 0; i < sizeof(wday)/sizeof(wday[0]); i++) {
+    if (strncmp(s, wday[i], strlen(wday[i])) == 0) {
+      tmptm.tm_wday = i;
+      s += strlen(wday[i]);
+      break;
+    }
+  }
+  if (i == sizeof(wday)/sizeof(wday[0])) return -1;
+  if (*s != ',' && *s != ' ') return -1;
+  s++;
+
+  /* Jan */
+  for(i = 0; i < sizeof(mon)/sizeof(mon[0]); i++) {
+    if (strncmp(s, mon[i], strlen(mon[i])) == 0) {
+      tmptm.tm_mon = i;
+      s += strlen(mon[i]);
+      break;
+    }
+  }
+  if (i == sizeof(mon)/sizeof(mon[0])) return -1;
+  if (*s != ',' && *s != ' ') return -1;
+  s++;
+
+  /* 25 */
+  tmptm.tm_mday = atoi(s);
+  while (isdigit(*s)) s++;
+  if (*s != ',' && *s != ' ') return -1;
+  s++;
+
+  /* 00:00:00 */
+  if (!(isdigit(s[0]) && isdigit(s[1]) && s[2] == ':'
+              && isdigit(s[3]) && isdigit(s[4]) && s[5] == ':'
+              && isdigit(s[6]) && isdigit(s[7]) && s[8] == ' ')) return -1;
+  tmptm.tm_hour = atoi(s);
+  tmptm.tm_min = atoi(s+3);
+  tmptm.tm_sec = atoi(s+6);
+  if (tmptm.tm_hour >= 24 || tmptm.tm_min >= 60 || tmptm.tm_sec >= 60) return -1;
+  s += 9;
+
+  /* +0000 */
+  if (s[0] == '+' || s[1] == '-') s++;
+  while (isdigit(*s)) s++;
+  if (*s != ',' && *s != ' ') return -1;
+  s++;
+  tmptm.tm_isdst = 0;
+
+  /* 2002 */
+  tmptm.tm_year = atoi(s) - 1900;
+
+  tmptm.tm_yday = 0;
+  tmptime = mktime(&tmptm) - timezone;
+  memcpy(tm, localtime(&tmptime), sizeof(struct tm));
+  return mktime(tm);
+}
+
+static int
+open_url(const gchar* url) {
+  int r = 0;
+#if defined(_WIN32)
+  r = (int) ShellExecute(NULL, "open", url, NULL, NULL, SW_SHOW);
+#elif defined(MACOSX)
+  gchar* command = g_strdup_printf("open '%s'", url);
+  g_spawn_command_line_async(command, NULL);
+  g_free(command);
+#else
+  gchar* command = g_strdup_printf("xdg-open '%s'", url);
+  g_spawn_command_line_async(command, NULL);
+  g_free(command);
+#endif
+  return r;
+}
+
+static void
+clean_context(GtkWidget* window) {
+  const char* prop_names[] = {
+    "mode", "user_id", "user_name", "status_id",
+    "last_status_id", "in_reply_to_status_id", "search",
+    "timeline_key", "first_status_id", "since_id",
+    NULL
+  };
+  const char** prop_name = prop_names;
+  while (*prop_name) {
+    gchar* prop_data = g_object_get_data(G_OBJECT(window), *prop_name);
+    if (prop_data) {
+      g_free(prop_data);
+      g_object_set_data(G_OBJECT(window), *prop_name, NULL);
+    }
+    prop_name++;
+  }
+  g_object_set_data(G_OBJECT(window), "tooltip_data", NULL);
+  hover_stop(window);
+}
+
+/**
+ * status bar
+ */
+static gchar*
+get_size_text_alloc(guint64 size) {
+  if (size < 1024)
+    return g_strdup_printf("%d B", (int) size);
+  if (size < 1024 * 1024)
+    return g_strdup_printf("%.1f KB", size / 1024.0);
+  return g_strdup_printf("%.1f MB", size / (1024.0 * 1024.0));
+}
+
+#define TIMING_MS(x) ((x) > 0 ? (int) ((x) * 1000 + 0.5) : 0)
+
+/* phases of the last refresh in milliseconds */
+static gchar*
+get_timing_text_alloc() {
+  HTTP_TIMING* t = &http_last_refresh;
+  double connected = t->appconnect > t->connect ? t->appconnect : t->connect;
+  HTTP_STATS* stats;
+
+  if (!http_last_refresh_endpoint) return g_strdup("");
+  stats = (HTTP_STATS*) g_hash_table_lookup(http_stats, http_last_refresh_endpoint);
+  return g_strdup_printf(
+          _("dns %d, connect %d, tls %d, wait %d, transfer %d, total %d ms (p90 %d ms) / "),
+          TIMING_MS(t->namelookup),
+          TIMING_MS(t->connect - t->namelookup),
+          t->appconnect > 0 ? TIMING_MS(t->appconnect - t->connect) : 0,
+          TIMING_MS(t->starttransfer - connected),
+          TIMING_MS(t->total - t->starttransfer),
+          TIMING_MS(t->total),
+          TIMING_MS(http_stats_percentile(stats, 90)));
+}
+
+#undef TIMING_MS
+
+/* remaining calls of the last refreshed endpoint, NULL if not known */
+static gchar*
+get_ratelimit_text_alloc() {
+  RATE_BUDGET budget;
+  struct tm localtm = {0};
+  char localdate[256];
+
+  if (!rate_budget_lookup(http_last_refresh_endpoint, &budget)) return NULL;
+  memcpy(&localtm, localtime(&budget.reset), sizeof(struct tm));
+  strftime(localdate, sizeof(localdate), "%X", &localtm);
+  return g_strdup_printf(_("%d/%d times before %s"),
+          budget.remaining, budget.limit, localdate);
+}
+
+static void
+update_statusbar(GtkWidget* window) {
+  GtkWidget* statusbar = (GtkWidget*) g_object_get_data(G_OBJECT(window), "statusbar");
+  guint context_id = (guint) g_object_get_data(G_OBJECT(statusbar), "context_id");
+  gchar* ratelimit = get_ratelimit_text_alloc();
+  gchar* timing = get_timing_text_alloc();
+  gchar* wire = get_size_text_alloc(http_wire_bytes);
+  gchar* decoded = get_size_text_alloc(http_decoded_bytes);
+  gchar* text;
+
+  text = g_strdup_printf(_("%s%s%sreceived %s (%s decoded)"),
+          ratelimit ? ratelimit : "",
+          ratelimit ? " / " : "",
+          timing, wire, decoded);
+  gtk_statusbar_pop(GTK_STATUSBAR(statusbar), context_id);
+  gtk_statusbar_push(GTK_STATUSBAR(statusbar), context_id, text);
+  g_free(text);
+  g_free(ratelimit);
+  g_free(timing);
+  g_free(wire);
+  g_free(decoded);
+}
+
+/**
+ * short urls
+ *
+ * where t.co, bit.ly and the like point to. a HEAD request follows the
+ * whole redirect chain, up to SHORT_URL_MAX_REDIRECTS, without a body, and
+ * services which refuse HEAD are asked for the first byte by a ranged GET.
+ * results are kept in the XDG cache dir keyed by short url. links of each
+ * page are resolved from the background, so hover cards need no request.
+ */
+static const char* short_url_hosts[] = {
+  "t.co", "bit.ly", "j.mp", "goo.gl", "ow.ly", "is.gd", "tinyurl.com", NULL
+};
+
+typedef struct _SHORT_URL {
+  gchar* url;
+  time_t updated;
+} SHORT_URL;
+
+/* short url -> SHORT_URL */
+static GHashTable* short_urls = NULL;
+/* short urls being resolved from the background */
+static GHashTable* short_url_pending = NULL;
+static GStaticMutex short_url_mutex = G_STATIC_MUTEX_INIT;
+
+static void
+short_url_free(SHORT_URL* entry) {
+  g_free(entry->url);
+  g_free(entry);
+}
+
+static gboolean
+is_short_url(const char* url) {
+  const char* host;
+  int n;
+
+  if (!strncmp(url, "http://", 7)) host = url + 7;
+  else if (!strncmp(url, "https://", 8)) host = url + 8;
+  else return FALSE;
+  for (n = 0; short_url_hosts[n]; n++) {
+    size_t len = strlen(short_url_hosts[n]);
+    if (!strncasecmp(host, short_url_hosts[n], len) && host[len] == '/')
+      return TRUE;
+  }
+  return FALSE;
+}
+
+static void
+short_url_load() {
+  gchar* path = http_condition_path_alloc(SHORT_URL_FILE);
+  gchar* contents = NULL;
+  time_t now = time(0);
+  gchar** lines;
+  int n;
+
+  short_urls = g_hash_table_new_full(g_str_hash, g_str_equal,
+          g_free, (GDestroyNotify) short_url_free);
+  short_url_pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  if (g_file_get_contents(path, &contents, NULL, NULL)) {
+    /* short url \t url \t updated */
+    lines = g_strsplit(contents, "\n", -1);
+    for (n = 0; lines[n]; n++) {
+      gchar** fields = g_strsplit(lines[n], "\t", 3);
+      if (fields[0] && fields[1] && fields[2]) {
+        time_t updated = (time_t) strtol(fields[2], NULL, 10);
+        if (now - updated < SHORT_URL_CACHE_TTL) {
+          SHORT_URL* entry = (SHORT_URL*) g_malloc0(sizeof(SHORT_URL));
+          entry->url = g_strdup(fields[1]);
+          entry->updated = updated;
+          g_hash_table_replace(short_urls, g_strdup(fields[0]), entry);
+        }
+      }
+      g_strfreev(fields);
+    }
+    g_strfreev(lines);
+    g_free(contents);
+  }
+  g_free(path);
+}
+
+static void
+short_url_save() {
+  gchar* path = http_condition_path_alloc(SHORT_URL_FILE);
+  gchar* dir = g_path_get_dirname(path);
+  GString* contents = g_string_new(NULL);
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_static_mutex_lock(&short_url_mutex);
+  g_hash_table_iter_init(&iter, short_urls);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    SHORT_URL* entry = (SHORT_URL*) value;
+    g_string_append_printf(contents, "%s\t%s\t%ld\n", (gchar*) key,
+            entry->url, (long) entry->updated);
+  }
+  g_static_mutex_unlock(&short_url_mutex);
+  g_mkdir_with_parents(dir, 0700);
+  g_file_set_contents(path, contents->str, contents->len, NULL);
+  g_string_free(contents, TRUE);
+  g_free(dir);
+  g_free(path);
+}
+
+/* where url points to, NULL if it wasn't resolved yet */
+static gchar*
+short_url_lookup_alloc(const char* url) {
+  SHORT_URL* entry;
+  gchar* result = NULL;
+
+  g_static_mutex_lock(&short_url_mutex);
+  entry = (SHORT_URL*) g_hash_table_lookup(short_urls, url);
+  if (entry) result = g_strdup(entry->url);
+  g_static_mutex_unlock(&short_url_mutex);
+  return result;
+}
+
+static void
+short_url_store(const char* url, const char* expanded) {
+  SHORT_URL* entry;
+
+  /* the cache file is tab and line separated */
+  if (strpbrk(url, "\t\r\n") || strpbrk(expanded, "\t\r\n")) return;
+  entry = (SHORT_URL*) g_malloc0(sizeof(SHORT_URL));
+  entry->url = g_strdup(expanded);
+  entry->updated = time(0);
+  g_static_mutex_lock(&short_url_mutex);
+  g_hash_table_replace(short_urls, g_strdup(url), entry);
+  g_static_mutex_unlock(&short_url_mutex);
+}
+
+/* asks where url leads to by HEAD, or by a ranged GET if ranged */
+static HTTP_REQUEST*
+short_url_request_new(const char* url, gboolean ranged) {
+  HTTP_REQUEST* req = http_request_new(NULL, url);
+  if (!req) return NULL;
+  req->priority = HTTP_PRIORITY_BACKGROUND;
+  /* only the location matters */
+  req->write_data = NULL;
+  curl_easy_setopt(req->curl, CURLOPT_MAXREDIRS, (long) SHORT_URL_MAX_REDIRECTS);
+  if (ranged) {
+    curl_easy_setopt(req->curl, CURLOPT_RANGE, "0-0");
+  } else {
+    req->method = "HEAD";
+    curl_easy_setopt(req->curl, CURLOPT_NOBODY, 1L);
+  }
+  return req;
+}
+
+/* end of the redirect chain, NULL if req didn't leave its url. a chain
+ * cut short by the limit or an unreachable target still tells where the
+ * short url points to */
+static gchar*
+short_url_result_alloc(HTTP_REQUEST* req) {
+  char* effective = NULL;
+
+  if (req->res == CURLE_ABORTED_BY_CALLBACK) return NULL;
+  curl_easy_getinfo(req->curl, CURLINFO_EFFECTIVE_URL, &effective);
+  if (!effective || !strcmp(effective, req->url)) return NULL;
+  return g_strdup(effective);
+}
+
+/* service itself didn't answer HEAD */
+static gboolean
+short_url_refused(HTTP_REQUEST* req) {
+  return !strcmp(req->method, "HEAD") &&
+      req->res != CURLE_ABORTED_BY_CALLBACK &&
+      (req->res != CURLE_OK || req->http_status >= 400);
+}
+
+static void
+short_url_resolved(HTTP_REQUEST* req, gpointer user_data) {
+  gchar* url = (gchar*) user_data;
+  gchar* result = short_url_result_alloc(req);
+
+  if (!result && short_url_refused(req)) {
+    HTTP_REQUEST* retry = short_url_request_new(url, TRUE);
+    if (retry) {
+      http_request_free(req);
+      http_request_submit(retry, short_url_resolved, url);
+      return;
+    }
+  }
+  if (result) short_url_store(url, result);
+  g_static_mutex_lock(&short_url_mutex);
+  g_hash_table_remove(short_url_pending, url);
+  g_static_mutex_unlock(&short_url_mutex);
+  g_free(result);
+  g_free(url);
+  http_request_free(req);
+}
+
+/* adds short urls of tweet which are not resolved yet to urls, entities
+ * already tell where t.co links point to */
+static void
+short_url_collect(JSON_Object* tweet, GHashTable* urls) {
+  JSON_Array* entities = json_object_dotget_array(tweet, "entities.urls");
+  const char* ptr = json_object_get_string(tweet, "text");
+  int n;
+
+  for (n = 0; entities && n < (int) json_array_get_count(entities); n++) {
+    JSON_Object* entity = json_array_get_object(entities, n);
+    const char* url = json_object_get_string(entity, "url");
+    const char* expanded = json_object_get_string(entity, "expanded_url");
+    if (url && expanded && strcmp(url, expanded) && is_short_url(url))
+      short_url_store(url, expanded);
+  }
+  while (ptr && (ptr = strstr(ptr, "http"))) {
+    const char* tmp = ptr;
+    gchar* url;
+    while (*tmp && strchr(ACCEPT_LETTER_URL, *tmp)) tmp++;
+    url = g_strndup(ptr, tmp - ptr);
+    ptr = tmp;
+    if (is_short_url(url) && !g_hash_table_lookup(urls, url)) {
+      gchar* expanded = short_url_lookup_alloc(url);
+      if (!expanded) {
+        g_hash_table_insert(urls, url, GINT_TO_POINTER(TRUE));
+        continue;
+      }
+      g_free(expanded);
+    }
+    g_free(url);
+  }
+}
+
+/* resolves short urls (url -> TRUE) in parallel from the background */
+static void
+short_url_prefetch(GHashTable* urls) {
+  GHashTableIter iter;
+  gpointer key;
+
+  g_hash_table_iter_init(&iter, urls);
+  while (g_hash_table_iter_next(&iter, &key, NULL)) {
+    const gchar* url = (const gchar*) key;
+    HTTP_REQUEST* req;
+    gboolean known;
+
+    g_static_mutex_lock(&short_url_mutex);
+    known = g_hash_table_lookup(short_urls, url) ||
+        g_hash_table_lookup(short_url_pending, url);
+    if (!known)
+      g_hash_table_insert(short_url_pending, g_strdup(url), GINT_TO_POINTER(TRUE));
+    g_static_mutex_unlock(&short_url_mutex);
+    if (known) continue;
+
+    req = short_url_request_new(url, FALSE);
+    if (req)
+      http_request_submit(req, short_url_resolved, g_strdup(url));
+    else {
+      g_static_mutex_lock(&short_url_mutex);
+      g_hash_table_remove(short_url_pending, url);
+      g_static_mutex_unlock(&short_url_mutex);
+    }
+  }
+}
+
+/**
+ * user store
+ *
+ * process-wide table of the users seen in any response. timelines are
+ * asked for trim_user=true, which leaves only the id of the author in each
+ * status, and name and icon are taken from here. users not stored yet are
+ * filled in batches by users/lookup.
+ *
+ * it is the profile cache of hover cards as well: authors and @mentions of
+ * each rendered page are looked up from the background unless they were
+ * updated within PROFILE_CACHE_TTL, so a card is shown without a request.
+ */
+typedef struct _USER_INFO {
+  gchar* id;
+  gchar* name;
+  gchar* screen_name;
+  gchar* profile_image_url;
+  gchar* description;
+  gchar* location;
+  gchar* url;
+  time_t updated;
+} USER_INFO;
+
+static GHashTable* user_store = NULL;
+static GHashTable* user_store_names = NULL;
+static GStaticMutex user_store_mutex = G_STATIC_MUTEX_INIT;
+
+static void
+user_info_free(USER_INFO* user) {
+  if (!user) return;
+  g_free(user->id);
+  g_free(user->name);
+  g_free(user->screen_name);
+  g_free(user->profile_image_url);
+  g_free(user->description);
+  g_free(user->location);
+  g_free(user->url);
+  g_free(user);
+}
+
+static USER_INFO*
+user_info_new(const char* id, const char* name, const char* screen_name, const char* icon) {
+  USER_INFO* user = (USER_INFO*) g_malloc0(sizeof(USER_INFO));
+  user->id = g_strdup(id);
+  user->name = g_strdup(name);
+  user->screen_name = g_strdup(screen_name);
+  user->profile_image_url = g_strdup(icon);
+  user->updated = time(0);
+  return user;
+}
+
+static USER_INFO*
+user_info_copy(const USER_INFO* user) {
+  USER_INFO* copy = user_info_new(user->id, user->name,
+          user->screen_name, user->profile_image_url);
+  copy->description = g_strdup(user->description);
+  copy->location = g_strdup(user->location);
+  copy->url = g_strdup(user->url);
+  copy->updated = user->updated;
+  return copy;
+}
+
+/* NULL for trimmed user objects, which carry nothing but the id */
+static USER_INFO*
+user_info_from_json(JSON_Object* object) {
+  const char* id = json_object_get_string(object, "id_str");
+  const char* screen_name = json_object_get_string(object, "screen_name");
+  USER_INFO* user;
+
+  if (!id || !screen_name) return NULL;
+  user = user_info_new(id,
+          json_object_get_string(object, "name"),
+          screen_name,
+          json_object_get_string(object, "profile_image_url"));
+  user->description = g_strdup(json_object_get_string(object, "description"));
+  user->location = g_strdup(json_object_get_string(object, "location"));
+  user->url = g_strdup(json_object_get_string(object, "url"));
+  return user;
+}
+
+static void
+user_store_add(JSON_Object* object) {
+  USER_INFO* user = user_info_from_json(object);
+
+  if (!user) return;
+  g_static_mutex_lock(&user_store_mutex);
+  if (!user_store) {
+    user_store = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, (GDestroyNotify) user_info_free);
+    user_store_names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  }
+  /* screen names are case insensitive */
+  g_hash_table_replace(user_store_names,
+          g_ascii_strdown(user->screen_name, -1), g_strdup(user->id));
+  g_hash_table_replace(user_store, g_strdup(user->id), user);
+  g_static_mutex_unlock(&user_store_mutex);
+}
+
+/**
+ * copy of the user stored under key, an id or a screen name. NULL if
+ * unknown, or if ttl is not 0 and it was updated longer than ttl ago.
+ */
+static USER_INFO*
+user_store_find(const char* key, time_t ttl) {
+  USER_INFO* user = NULL;
+
+  if (!key) return NULL;
+  g_static_mutex_lock(&user_store_mutex);
+  if (user_store) {
+    user = (USER_INFO*) g_hash_table_lookup(user_store, key);
+    if (!user) {
+      gchar* name = g_ascii_strdown(key, -1);
+      const char* id = (const char*) g_hash_table_lookup(user_store_names, name);
+      if (id) user = (USER_INFO*) g_hash_table_lookup(user_store, id);
+      g_free(name);
+    }
+  }
+  if (user && ttl && time(0) - user->updated >= ttl) user = NULL;
+  if (user) user = user_info_copy(user);
+  g_static_mutex_unlock(&user_store_mutex);
+  return user;
+}
+
+/* copy of the stored user with id, NULL if unknown */
+static USER_INFO*
+user_store_lookup(const char* id) {
+  return user_store_find(id, 0);
+}
 
-          link = tmp = ptr + 1;
-          while(*tmp && strchr(ACCEPT_LETTER_TAG, *tmp)) tmp++;
-          len = (int)(tmp-link);
-          if (len) {
-            link = malloc(len+2);
-            memset(link, 0, len+2);
-            strncpy(link, ptr, len+1);
-            tag = gtk_text_buffer_create_tag(
-                    buffer,
-                    NULL,
-                    "foreground",
-                    "darkgreen",
-                    "underline",
-                    PANGO_UNDERLINE_SINGLE,
-                    NULL);
-            g_object_set_data(G_OBJECT(tag), "tag_name", (gpointer) link);
-            gtk_text_buffer_insert_with_tags(buffer, iter, link, -1, tag, NULL);
-            ptr = last = tmp;
-          } else
-            ptr = tmp;
-        }
-    ptr++;
+/* keys is a comma separated list of up to USER_LOOKUP_MAX ids or names */
+static void
+user_store_fetch_batch(const char* param, const char* keys, HTTP_PRIORITY priority) {
+  HTTP_REQUEST* req;
+  JSON_Value* root_value;
+  JSON_Array* users;
+  char* url;
+  OAUTH_PARAM params[1];
+  char* body;
+  int n;
+
+  url = get_api_url_alloc(SERVICE_USERS_LOOKUP_URL);
+
+  params[0].name = param;
+  params[0].value = keys;
+  req = oauth_request_new(SERVICE_USERS_LOOKUP_URL, "GET", url, params, 1);
+  g_free(url);
+  if (req) req->priority = priority;
+  if (http_request_perform(req) != CURLE_OK || req->http_status != 200 ||
+          !(body = memfdetach(req->body))) {
+    http_request_free(req);
+    return;
   }
-  if (last != ptr && strlen(last))
-    gtk_text_buffer_insert(buffer, iter, last, ptr-last);
+  http_request_free(req);
+
+  root_value = json_parse_string(body);
+  users = json_value_get_array(root_value);
+  for (n = 0; n < json_array_get_count(users); n++)
+    user_store_add(json_array_get_object(users, n));
+  if (root_value) json_value_free(root_value);
+  free(body);
 }
 
-static time_t
-tweettime_to_time(struct tm* tm, const char* s) {
-  int i;
-  struct tm tmptm;
-  time_t tmptime;
+/* look up users by param (user_id or screen_name), USER_LOOKUP_MAX in a request */
+static void
+user_store_fetch(GPtrArray* keys, const char* param, HTTP_PRIORITY priority) {
+  guint n = 0;
+
+  while (n < keys->len) {
+    GString* list;
+    guint count;
+    /* prefetch is the first thing to give up when the budget runs low */
+    if (priority == HTTP_PRIORITY_BACKGROUND &&
+            !rate_budget_allows(SERVICE_USERS_LOOKUP_URL, TRUE))
+      return;
+    list = g_string_new(NULL);
+    for (count = 0; n < keys->len && count < USER_LOOKUP_MAX; n++, count++) {
+      if (count) g_string_append_c(list, ',');
+      g_string_append(list, (const char*) g_ptr_array_index(keys, n));
+    }
+    user_store_fetch_batch(param, list->str, priority);
+    g_string_free(list, TRUE);
+  }
+}
 
-  static char* wday[] = {
-    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat",
-    NULL
-  };
-  static char* mon[] = {
-    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
-    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
-    NULL
-  };
+typedef struct _USER_PREFETCH {
+  GPtrArray* ids;
+  GPtrArray* names;
+} USER_PREFETCH;
 
-  memset(&tmptm, 0, sizeof(tmptm));
-  /* Sun */
-  for(i = 0; i < sizeof(wday)/sizeof(wday[0]); i++) {
-    if (strncmp(s, wday[i], strlen(wday[i])) == 0) {
-      tmptm.tm_wday = i;
-      s += strlen(wday[i]);
-      break;
+static void
+user_prefetch_free(USER_PREFETCH* prefetch) {
+  g_ptr_array_foreach(prefetch->ids, (GFunc) g_free, NULL);
+  g_ptr_array_free(prefetch->ids, TRUE);
+  g_ptr_array_foreach(prefetch->names, (GFunc) g_free, NULL);
+  g_ptr_array_free(prefetch->names, TRUE);
+  g_free(prefetch);
+}
+
+static gpointer
+user_prefetch_thread(gpointer data) {
+  USER_PREFETCH* prefetch = (USER_PREFETCH*) data;
+  user_store_fetch(prefetch->ids, "user_id", HTTP_PRIORITY_BACKGROUND);
+  user_store_fetch(prefetch->names, "screen_name", HTTP_PRIORITY_BACKGROUND);
+  user_prefetch_free(prefetch);
+  return NULL;
+}
+
+static void
+user_prefetch_collect(gpointer key, gpointer value, gpointer user_data) {
+  USER_INFO* user = user_store_find((const char*) key, PROFILE_CACHE_TTL);
+  if (!user)
+    g_ptr_array_add((GPtrArray*) user_data, g_strdup((const char*) key));
+  user_info_free(user);
+}
+
+/* look up users of ids and names which are unknown or stale, from the background */
+static void
+user_prefetch(GHashTable* ids, GHashTable* names) {
+  USER_PREFETCH* prefetch = (USER_PREFETCH*) g_malloc0(sizeof(USER_PREFETCH));
+
+  prefetch->ids = g_ptr_array_new();
+  prefetch->names = g_ptr_array_new();
+  g_hash_table_foreach(ids, user_prefetch_collect, prefetch->ids);
+  g_hash_table_foreach(names, user_prefetch_collect, prefetch->names);
+  if ((!prefetch->ids->len && !prefetch->names->len) ||
+          !rate_budget_allows(SERVICE_USERS_LOOKUP_URL, TRUE) ||
+          !g_thread_create(user_prefetch_thread, prefetch, FALSE, NULL))
+    user_prefetch_free(prefetch);
+}
+
+/* hover card text of user */
+static gchar*
+get_profile_text_alloc(USER_INFO* user) {
+  return g_strdup_printf(
+          "user name:%s\n"
+          "screen name:%s\n"
+          "description:%s\n"
+          "location:%s\n"
+          "url:%s\n",
+          user->name ? user->name : "",
+          user->screen_name ? user->screen_name : "",
+          user->description ? user->description : "",
+          user->location ? user->location : "",
+          user->url ? user->url : "");
+}
+
+/**
+ * status icons
+ *
+ * avatars by url, shared by every timeline. a status whose avatar isn't
+ * loaded yet shows a blank one, with a mark in front of it which waits in
+ * status_icon_waiting until the download swaps the avatar in. the gdk lock
+ * guards all of them.
+ */
+static GHashTable* status_icons = NULL;
+static GHashTable* status_icon_waiting = NULL;
+static GdkPixbuf* status_icon_blank = NULL;
+
+/* keeps pixbuf of url scaled for the timeline, pixbuf is taken */
+static GdkPixbuf*
+status_icon_store(const char* url, GdkPixbuf* pixbuf) {
+  GdkPixbuf* icon;
+
+  if (!pixbuf) return NULL;
+  icon = gdk_pixbuf_scale_simple(pixbuf, 32, 32, GDK_INTERP_TILES);
+  if (icon)
+    g_object_unref(pixbuf);
+  else
+    icon = pixbuf;
+  g_hash_table_replace(status_icons, g_strdup(url), icon);
+  return icon;
+}
+
+static void
+status_icon_loaded(HTTP_REQUEST* req, gpointer user_data) {
+  gchar* url = (gchar*) user_data;
+  GdkPixbuf* pixbuf = http_response_pixbuf(req, NULL);
+  GSList* marks;
+
+  http_request_free(req);
+  gdk_threads_enter();
+  pixbuf = status_icon_store(url, pixbuf);
+  marks = (GSList*) g_hash_table_lookup(status_icon_waiting, url);
+  g_hash_table_remove(status_icon_waiting, url);
+  while (marks) {
+    GtkTextMark* mark = (GtkTextMark*) marks->data;
+    GtkTextBuffer* buffer = gtk_text_mark_get_buffer(mark);
+    if (buffer) {
+      GtkTextIter start, end;
+      gtk_text_buffer_get_iter_at_mark(buffer, &start, mark);
+      end = start;
+      /* a reload may have taken the status away meanwhile */
+      if (pixbuf && gtk_text_iter_get_pixbuf(&start) == status_icon_blank &&
+              gtk_text_iter_forward_char(&end)) {
+        gtk_text_buffer_delete(buffer, &start, &end);
+        gtk_text_buffer_insert_pixbuf(buffer, &start, pixbuf);
+      }
+      gtk_text_buffer_delete_mark(buffer, mark);
     }
+    g_object_unref(mark);
+    marks = g_slist_delete_link(marks, marks);
   }
-  if (i == sizeof(wday)/sizeof(wday[0])) return -1;
-  if (*s != ',' && *s != ' ') return -1;
-  s++;
+  gdk_threads_leave();
+  g_free(url);
+}
 
-  /* Jan */
-  for(i = 0; i < sizeof(mon)/sizeof(mon[0]); i++) {
-    if (strncmp(s, mon[i], strlen(mon[i])) == 0) {
-      tmptm.tm_mon = i;
-      s += strlen(mon[i]);
-      break;
-    }
+/* avatar of user at iter, gdk lock must be held */
+static void
+status_icon_insert(GtkTextBuffer* buffer, GtkTextIter* iter, USER_INFO* user) {
+  const char* icon = user->profile_image_url;
+  GdkPixbuf* pixbuf;
+  GtkTextMark* mark;
+  GSList* marks;
+
+  if (!icon) return;
+  if (!status_icons) {
+    status_icons = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
+    status_icon_waiting = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    status_icon_blank = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, 32, 32);
+    gdk_pixbuf_fill(status_icon_blank, 0);
+  }
+  pixbuf = (GdkPixbuf*) g_hash_table_lookup(status_icons, icon);
+  /* local files are read right away */
+  if (!pixbuf &&
+          (!strncmp(icon, "file:///", 8) || g_file_test(icon, G_FILE_TEST_EXISTS))) {
+    gchar* path = g_filename_from_uri(icon, NULL, NULL);
+    pixbuf = status_icon_store(icon,
+            gdk_pixbuf_new_from_file(path ? path : icon, NULL));
+    g_free(path);
+    if (!pixbuf) return;
+  }
+  if (pixbuf) {
+    gtk_text_buffer_insert_pixbuf(buffer, iter, pixbuf);
+    return;
   }
-  if (i == sizeof(mon)/sizeof(mon[0])) return -1;
-  if (*s != ',' && *s != ' ') return -1;
-  s++;
 
-  /* 25 */
-  tmptm.tm_mday = atoi(s);
-  while (isdigit(*s)) s++;
-  if (*s != ',' && *s != ' ') return -1;
-  s++;
+  /* avoid to duplicate downloading of icon. */
+  marks = (GSList*) g_hash_table_lookup(status_icon_waiting, icon);
+  if (!marks) {
+    HTTP_REQUEST* req = http_request_new(NULL, icon);
+    if (!req) return;
+    req->priority = HTTP_PRIORITY_BACKGROUND;
+    http_request_set_conditional(req, FALSE);
+    /* status_icon_loaded waits for the gdk lock, so the mark is in first */
+    http_request_submit(req, status_icon_loaded, g_strdup(icon));
+  }
+  mark = gtk_text_buffer_create_mark(buffer, NULL, iter, TRUE);
+  g_hash_table_replace(status_icon_waiting, g_strdup(icon),
+          g_slist_prepend(marks, g_object_ref(mark)));
+  gtk_text_buffer_insert_pixbuf(buffer, iter, status_icon_blank);
+}
 
-  /* 00:00:00 */
-  if (!(isdigit(s[0]) && isdigit(s[1]) && s[2] == ':'
-              && isdigit(s[3]) && isdigit(s[4]) && s[5] == ':'
-              && isdigit(s[6]) && isdigit(s[7]) && s[8] == ' ')) return -1;
-  tmptm.tm_hour = atoi(s);
-  tmptm.tm_min = atoi(s+3);
-  tmptm.tm_sec = atoi(s+6);
-  if (tmptm.tm_hour >= 24 || tmptm.tm_min >= 60 || tmptm.tm_sec >= 60) return -1;
-  s += 9;
+/**
+ * status renderer
+ */
+/* gdk lock must be held */
+static void
+insert_status(GtkTextBuffer* buffer, GtkTextIter* iter, JSON_Object* tweet, USER_INFO* user, GHashTable* mentions) {
+  const char* id = json_object_dotget_string(tweet, "id_str");
+  const char* user_id = user->id;
+  const char* real = user->name;
+  const char* user_name = user->screen_name;
+  const char* text = json_object_dotget_string(tweet, "text");
+  const char* date = json_object_dotget_string(tweet, "created_at");
+  int favorited = json_object_dotget_boolean(tweet, "favorited");
+  int retweeted = json_object_dotget_boolean(tweet, "retweeted");
+  GtkTextTag* tag = NULL;
+  struct tm localtm;
+  char localdate[256];
 
-  /* +0000 */
-  if (s[0] == '+' || s[1] == '-') s++;
-  while (isdigit(*s)) s++;
-  if (*s != ',' && *s != ' ') return -1;
-  s++;
-  tmptm.tm_isdst = 0;
+  /**
+   * layout:
+   *
+   * [icon] [name:name_tag]
+   * [message]
+   * [date:date_tag]
+   *
+   */
+  status_icon_insert(buffer, iter, user);
+  gtk_text_buffer_insert(buffer, iter, " ", -1);
+
+  tag = gtk_text_buffer_create_tag(
+          buffer,
+          NULL,
+          "scale",
+          PANGO_SCALE_LARGE,
+          "underline",
+          PANGO_UNDERLINE_SINGLE,
+          "weight",
+          PANGO_WEIGHT_BOLD,
+          "foreground",
+          "#0000FF",
+          NULL);
+  g_object_set_data(G_OBJECT(tag), "user_id", g_strdup(user_id));
+  g_object_set_data(G_OBJECT(tag), "user_name", g_strdup(user_name));
+  gtk_text_buffer_insert_with_tags(buffer, iter, user_name, -1, tag, NULL);
+  gtk_text_buffer_insert(buffer, iter, " (", -1);
+  gtk_text_buffer_insert(buffer, iter, real, -1);
+  gtk_text_buffer_insert(buffer, iter, ")\n", -1);
+  insert_status_text(buffer, iter, text, mentions);
+  gtk_text_buffer_insert(buffer, iter, "\n", -1);
+
+  tweettime_to_time(&localtm, date);
+  strftime(localdate, sizeof(localdate), "%x %X", &localtm);
 
-  /* 2002 */
-  tmptm.tm_year = atoi(s) - 1900;
+  tag = gtk_text_buffer_create_tag(
+          buffer,
+          NULL,
+          "scale",
+          PANGO_SCALE_X_SMALL,
+          "style",
+          PANGO_STYLE_ITALIC,
+          "foreground",
+          "#005500",
+          NULL);
+  g_object_set_data(G_OBJECT(tag), "status_url", g_strdup_printf(SERVICE_STATUS_URL, user_name, id));
+  gtk_text_buffer_insert_with_tags(buffer, iter, localdate, -1, tag, NULL);
+
+  // reply
+  gtk_text_buffer_insert(buffer, iter, " ", -1);
+
+  tag = gtk_text_buffer_create_tag(
+          buffer,
+          NULL,
+          "scale",
+          PANGO_SCALE_X_SMALL,
+          "style",
+          PANGO_STYLE_ITALIC,
+          "foreground",
+          "#000055",
+          NULL);
+  g_object_set_data(G_OBJECT(tag), "reply", g_strdup(user_name));
+  g_object_set_data(G_OBJECT(tag), "in_reply_to_status_id", g_strdup(id));
+  gtk_text_buffer_insert_with_tags(buffer, iter, "reply", -1, tag, NULL);
+
+  // retweet
+  gtk_text_buffer_insert(buffer, iter, " ", -1);
+
+  tag = gtk_text_buffer_create_tag(
+          buffer,
+          NULL,
+          "scale",
+          PANGO_SCALE_X_SMALL,
+          "style",
+          PANGO_STYLE_ITALIC,
+          "foreground",
+          retweeted ? "#555555" : "#000055",
+          NULL);
+  g_object_set_data(G_OBJECT(tag), "retweet", g_strdup_printf((retweeted ? "-%s" : "%s"), id));
+  gtk_text_buffer_insert_with_tags(buffer, iter, "retweet", -1, tag, NULL);
+
+  // favorite
+  gtk_text_buffer_insert(buffer, iter, " ", -1);
+
+  tag = gtk_text_buffer_create_tag(
+          buffer,
+          NULL,
+          "scale",
+          PANGO_SCALE_X_SMALL,
+          "style",
+          PANGO_STYLE_ITALIC,
+          "foreground",
+          favorited ? "#555555" : "#000055",
+          NULL);
+  g_object_set_data(G_OBJECT(tag), "favorite", g_strdup_printf((favorited ? "-%s" : "%s"), id));
+  gtk_text_buffer_insert_with_tags(buffer, iter, "favorite", -1, tag, NULL);
 
-  tmptm.tm_yday = 0;
-  tmptime = mktime(&tmptm) - timezone;
-  memcpy(tm, localtime(&tmptime), sizeof(struct tm));
-  return mktime(tm);
+  gtk_text_buffer_insert(buffer, iter, "\n\n", -1);
 }
 
-static int
-open_url(const gchar* url) {
-  int r = 0;
-#if defined(_WIN32)
-  r = (int) ShellExecute(NULL, "open", url, NULL, NULL, SW_SHOW);
-#elif defined(MACOSX)
-  gchar* command = g_strdup_printf("open '%s'", url);
-  g_spawn_command_line_async(command, NULL);
-  g_free(command);
-#else
-  gchar* command = g_strdup_printf("xdg-open '%s'", url);
-  g_spawn_command_line_async(command, NULL);
-  g_free(command);
+/**
+ * timeline page
+ *
+ * one response rendered into the buffer. a full page replaces the timeline,
+ * a max_id page is appended below it and a since_id page is inserted above
+ * it. statuses already in the buffer are skipped, so no id is shown twice.
+ */
+typedef struct _TIMELINE_GAP TIMELINE_GAP;
+
+typedef struct _TIMELINE_PAGE {
+  GtkWidget* window;
+  GtkWidget* textview;
+  GtkTextBuffer* buffer;
+  GtkTextMark* mark;
+  GtkTextMark* top_mark;
+  TIMELINE_GAP* gap;
+  GSList* pending;
+  GHashTable* missing;
+  GHashTable* authors;
+  GHashTable* mentions;
+  GHashTable* links;
+  const gchar* title;
+  const char* endpoint;
+  const gchar* url;
+  const gchar* max_id;
+  const gchar* since_id;
+  int limit;
+  int count;
+  gchar* key;
+  gchar* first_id;
+  gchar* last_id;
+} TIMELINE_PAGE;
+
+/**
+ * timeline gap
+ *
+ * a poll which came back full didn't reach since_id, so statuses between
+ * its oldest one and since_id are missing. a placeholder line marks where
+ * they belong, and max_id bounded requests fill it from the background.
+ */
+struct _TIMELINE_GAP {
+  GtkWidget* window;
+  GtkTextMark* mark;
+  const char* endpoint;
+  gchar* url;
+  gchar* since_id;
+  gchar* max_id;
+  gboolean running;
+};
+
+static const char timeline_gap_text[] = "...\n\n";
+
+static void
+timeline_gap_free(TIMELINE_GAP* gap) {
+  g_object_unref(gap->mark);
+  g_free(gap->url);
+  g_free(gap->since_id);
+  g_free(gap->max_id);
+  g_free(gap);
+}
+
+/* gdk lock must be held, since_id and max_id are taken */
+static TIMELINE_GAP*
+timeline_gap_add(GtkWidget* window, GtkTextIter* iter,
+        const char* endpoint, const gchar* url, gchar* since_id, gchar* max_id) {
+  GtkTextBuffer* buffer = gtk_text_iter_get_buffer(iter);
+  GList* gaps = (GList*) g_object_get_data(G_OBJECT(window), "gaps");
+  TIMELINE_GAP* gap = (TIMELINE_GAP*) g_malloc0(sizeof(TIMELINE_GAP));
+  gint offset = gtk_text_iter_get_offset(iter);
+  GtkTextTag* tag;
+
+  tag = gtk_text_buffer_create_tag(
+          buffer,
+          NULL,
+          "style",
+          PANGO_STYLE_ITALIC,
+          "foreground",
+          "#555555",
+          NULL);
+  gtk_text_buffer_insert_with_tags(buffer, iter, timeline_gap_text, -1, tag, NULL);
+  gtk_text_buffer_get_iter_at_offset(buffer, iter, offset);
+
+  /* statuses inserted at the mark push it down, it stays on the placeholder */
+  gap->mark = (GtkTextMark*) g_object_ref(
+          gtk_text_buffer_create_mark(buffer, NULL, iter, FALSE));
+  gap->window = window;
+  gap->endpoint = endpoint;
+  gap->url = g_strdup(url);
+  gap->since_id = since_id;
+  gap->max_id = max_id;
+  g_object_set_data(G_OBJECT(window), "gaps", g_list_append(gaps, gap));
+  return gap;
+}
+
+/* gdk lock must be held */
+static void
+timeline_gap_remove(TIMELINE_GAP* gap) {
+  GtkTextBuffer* buffer = gtk_text_mark_get_buffer(gap->mark);
+  GList* gaps = (GList*) g_object_get_data(G_OBJECT(gap->window), "gaps");
+  GtkTextIter start, end;
+
+  gtk_text_buffer_get_iter_at_mark(buffer, &start, gap->mark);
+  end = start;
+  gtk_text_iter_forward_chars(&end, sizeof(timeline_gap_text) - 1);
+  gtk_text_buffer_delete(buffer, &start, &end);
+  gtk_text_buffer_delete_mark(buffer, gap->mark);
+  g_object_set_data(G_OBJECT(gap->window), "gaps", g_list_remove(gaps, gap));
+  timeline_gap_free(gap);
+}
+
+/* gdk lock must be held, running gaps are freed by their thread */
+static void
+timeline_gaps_reset(GtkWidget* window) {
+  GList* gaps = (GList*) g_object_get_data(G_OBJECT(window), "gaps");
+  GList* item;
+
+  for (item = gaps; item; item = item->next) {
+    TIMELINE_GAP* gap = (TIMELINE_GAP*) item->data;
+    if (!gtk_text_mark_get_deleted(gap->mark))
+      gtk_text_buffer_delete_mark(gtk_text_mark_get_buffer(gap->mark), gap->mark);
+    if (!gap->running) timeline_gap_free(gap);
+  }
+  g_list_free(gaps);
+  g_object_set_data(G_OBJECT(window), "gaps", NULL);
+}
+
+/* cut gap in n slices with placeholders of their own, gdk lock must be held */
+static void
+timeline_gap_split(TIMELINE_GAP* gap, int n) {
+  GtkTextBuffer* buffer = gtk_text_mark_get_buffer(gap->mark);
+  guint64 low = g_ascii_strtoull(gap->since_id, NULL, 10);
+  guint64 high = g_ascii_strtoull(gap->max_id, NULL, 10);
+  guint64 step;
+  TIMELINE_GAP* prev = gap;
+  int k;
+
+  if (n < 2 || high <= low + n) return;
+  /* ids grow with time, so slices span about the same time each */
+  step = (high - low) / n;
+  g_free(gap->since_id);
+  gap->since_id = g_strdup_printf("%" G_GUINT64_FORMAT, high - step);
+  for (k = 1; k < n; k++) {
+    GtkTextIter iter;
+    gchar* since_id = g_strdup_printf("%" G_GUINT64_FORMAT,
+            k == n - 1 ? low : high - (k + 1) * step);
+    gchar* max_id = g_strdup_printf("%" G_GUINT64_FORMAT, high - k * step);
+    gtk_text_buffer_get_iter_at_mark(buffer, &iter, prev->mark);
+    gtk_text_iter_forward_chars(&iter, sizeof(timeline_gap_text) - 1);
+    prev = timeline_gap_add(gap->window, &iter,
+            gap->endpoint, gap->url, since_id, max_id);
+  }
+}
+
+static void
+timeline_page_init(TIMELINE_PAGE* page, GtkWidget* window) {
+  memset(page, 0, sizeof(TIMELINE_PAGE));
+  page->window = window;
+  page->textview = (GtkWidget*) g_object_get_data(G_OBJECT(window), "textview");
+  page->authors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  page->mentions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  page->links = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+}
+
+static void
+timeline_page_free(TIMELINE_PAGE* page) {
+  g_slist_foreach(page->pending, (GFunc) json_value_free, NULL);
+  g_slist_free(page->pending);
+  if (page->missing) g_hash_table_destroy(page->missing);
+  g_hash_table_destroy(page->authors);
+  g_hash_table_destroy(page->mentions);
+  g_hash_table_destroy(page->links);
+  g_free(page->key);
+  g_free(page->first_id);
+  g_free(page->last_id);
+}
+
+/* ids of the statuses in the buffer, gdk lock must be held */
+static GHashTable*
+get_status_ids(GtkWidget* window, gboolean reset) {
+  GHashTable* ids = (GHashTable*) g_object_get_data(G_OBJECT(window), "status_ids");
+  if (!ids || reset) {
+    ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g_object_set_data_full(G_OBJECT(window), "status_ids", ids,
+            (GDestroyNotify) g_hash_table_destroy);
+  }
+  return ids;
+}
+
+/* id right below id, so max_id doesn't return the oldest status again */
+static gchar*
+get_older_id_alloc(const char* id) {
+  guint64 n = g_ascii_strtoull(id, NULL, 10);
+  return g_strdup_printf("%" G_GUINT64_FORMAT, n > 0 ? n - 1 : 0);
+}
+
+/* gdk lock must be held */
+static void
+timeline_page_begin(TIMELINE_PAGE* page) {
+  GtkTextIter iter;
+
+  if (page->title) gtk_window_set_title(GTK_WINDOW(page->window), page->title);
+  page->buffer = (GtkTextBuffer*) g_object_get_data(G_OBJECT(page->window), "buffer");
+  if (page->since_id) {
+    GdkRectangle rect;
+    /* new statuses go above, the line the reader is at stays put */
+    gtk_text_view_get_visible_rect(GTK_TEXT_VIEW(page->textview), &rect);
+    if (rect.y > 0) {
+      GtkTextIter top;
+      gtk_text_view_get_line_at_y(GTK_TEXT_VIEW(page->textview), &top, rect.y, NULL);
+      page->top_mark = gtk_text_buffer_create_mark(page->buffer, NULL, &top, FALSE);
+    }
+    /* backfill goes where its gap is */
+    if (page->gap) {
+      page->mark = page->gap->mark;
+      return;
+    }
+    gtk_text_buffer_get_start_iter(page->buffer, &iter);
+  } else if (page->max_id) {
+    gtk_text_buffer_get_end_iter(page->buffer, &iter);
+  } else {
+    gtk_text_buffer_set_text(page->buffer, "", 0);
+    get_status_ids(page->window, TRUE);
+    timeline_gaps_reset(page->window);
+    gtk_text_buffer_get_start_iter(page->buffer, &iter);
+  }
+  page->mark = gtk_text_buffer_create_mark(page->buffer, NULL, &iter, FALSE);
+}
+
+#ifdef GTKTWEETER_TEST
+/* called while timeline_page_insert doesn't hold the gdk lock */
+static void (*timeline_page_insert_hook)(TIMELINE_PAGE* page) = NULL;
 #endif
-  return r;
+
+static void
+timeline_page_insert(TIMELINE_PAGE* page, JSON_Object* tweet) {
+  const char* id = json_object_dotget_string(tweet, "id_str");
+  const char* user_id = json_object_dotget_string(tweet, "user.id_str");
+  GHashTable* ids;
+  USER_INFO* user;
+  GtkTextIter iter;
+
+  if (!id || !user_id) return;
+  /* cursors move even over statuses which are shown already */
+  page->count++;
+  if (!page->first_id) page->first_id = g_strdup(id);
+  g_free(page->last_id);
+  page->last_id = g_strdup(id);
+
+  gdk_threads_enter();
+  if (!page->buffer) timeline_page_begin(page);
+  ids = get_status_ids(page->window, FALSE);
+  /* timeline was reloaded under a backfill */
+  if (g_hash_table_lookup(ids, id) ||
+          (page->gap && gtk_text_mark_get_deleted(page->gap->mark))) {
+    gdk_threads_leave();
+    return;
+  }
+  g_hash_table_insert(ids, g_strdup(id), GINT_TO_POINTER(TRUE));
+  gdk_threads_leave();
+
+  user_store_add(json_object_get_object(tweet, "user"));
+  user = user_store_lookup(user_id);
+  /* users/lookup doesn't know suspended authors, show them by id */
+  if (!user) user = user_info_new(user_id, user_id, user_id, NULL);
+  g_hash_table_replace(page->authors, g_strdup(user_id), GINT_TO_POINTER(TRUE));
+  short_url_collect(tweet, page->links);
+#ifdef GTKTWEETER_TEST
+  if (timeline_page_insert_hook) timeline_page_insert_hook(page);
+#endif
+
+  gdk_threads_enter();
+  /* the lock was dropped, a reload may have deleted the gap meanwhile */
+  if (page->gap && gtk_text_mark_get_deleted(page->gap->mark)) {
+    gdk_threads_leave();
+    user_info_free(user);
+    return;
+  }
+  /* other pages may have changed the buffer meanwhile, marks keep up */
+  gtk_text_buffer_get_iter_at_mark(page->buffer, &iter, page->mark);
+  insert_status(page->buffer, &iter, tweet, user, page->mentions);
+  if (page->top_mark)
+    gtk_text_view_scroll_to_mark(GTK_TEXT_VIEW(page->textview),
+            page->top_mark, 0.0, TRUE, 0.0, 0.0);
+  gdk_threads_leave();
+  user_info_free(user);
+}
+
+/* render statuses held back, after their unknown authors are looked up */
+static void
+timeline_page_flush(TIMELINE_PAGE* page) {
+  GSList* pending = g_slist_reverse(page->pending);
+
+  page->pending = NULL;
+  if (page->missing) {
+    GPtrArray* ids = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer id;
+    g_hash_table_iter_init(&iter, page->missing);
+    while (g_hash_table_iter_next(&iter, &id, NULL))
+      g_ptr_array_add(ids, id);
+    user_store_fetch(ids, "user_id", HTTP_PRIORITY_FOREGROUND);
+    g_ptr_array_free(ids, TRUE);
+    g_hash_table_destroy(page->missing);
+    page->missing = NULL;
+  }
+  while (pending) {
+    JSON_Value* value = (JSON_Value*) pending->data;
+    timeline_page_insert(page, json_value_get_object(value));
+    json_value_free(value);
+    pending = g_slist_delete_link(pending, pending);
+  }
+}
+
+/**
+ * status of a trimmed timeline, value is taken. once an author is unknown
+ * the statuses after it wait as well, so the order on screen is kept, until
+ * the page ends or USER_LOOKUP_MAX authors are missing.
+ */
+static void
+timeline_page_add(TIMELINE_PAGE* page, JSON_Value* value) {
+  JSON_Object* tweet = json_value_get_object(value);
+  const char* user_id = json_object_dotget_string(tweet, "user.id_str");
+  USER_INFO* user;
+
+  if (!tweet || !user_id) {
+    json_value_free(value);
+    return;
+  }
+  user_store_add(json_object_get_object(tweet, "user"));
+  user = user_store_lookup(user_id);
+  if (user && !page->pending) {
+    user_info_free(user);
+    timeline_page_insert(page, tweet);
+    json_value_free(value);
+    return;
+  }
+  if (!user) {
+    if (!page->missing)
+      page->missing = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    g_hash_table_replace(page->missing, g_strdup(user_id), GINT_TO_POINTER(TRUE));
+  }
+  user_info_free(user);
+  page->pending = g_slist_prepend(page->pending, value);
+  if (page->missing && g_hash_table_size(page->missing) >= USER_LOOKUP_MAX)
+    timeline_page_flush(page);
+}
+
+/* keep cursors of a successful page, pollable is FALSE for thread view */
+static void
+timeline_page_finish(TIMELINE_PAGE* page, gboolean success, gboolean pollable) {
+  GObject* window = G_OBJECT(page->window);
+  TIMELINE_GAP* gap = page->gap;
+  GtkTextIter iter;
+  /* since_id wasn't reached when the page is full */
+  gboolean full;
+
+  if (page->pending) timeline_page_flush(page);
+  /* hover cards of this page need no request */
+  user_prefetch(page->authors, page->mentions);
+  g_hash_table_remove_all(page->authors);
+  g_hash_table_remove_all(page->mentions);
+  short_url_prefetch(page->links);
+  g_hash_table_remove_all(page->links);
+  full = page->limit > 0 && page->since_id && page->last_id &&
+      page->count >= page->limit;
+
+  gdk_threads_enter();
+  if (gap) gap->running = FALSE;
+  if (gap && gtk_text_mark_get_deleted(gap->mark)) {
+    timeline_gap_free(gap);
+    gdk_threads_leave();
+    return;
+  }
+  /* empty page still replaces the timeline */
+  if (success && !page->buffer) timeline_page_begin(page);
+  if (page->top_mark) {
+    gtk_text_buffer_delete_mark(page->buffer, page->top_mark);
+    page->top_mark = NULL;
+  }
+  if (success && full) {
+    gchar* max_id = get_older_id_alloc(page->last_id);
+    if (gap) {
+      /* rest of the gap is still missing */
+      g_free(gap->max_id);
+      gap->max_id = max_id;
+    } else {
+      gtk_text_buffer_get_iter_at_mark(page->buffer, &iter, page->mark);
+      timeline_gap_add(page->window, &iter, page->endpoint, page->url,
+              g_strdup(page->since_id), max_id);
+    }
+  } else if (success && gap) {
+    timeline_gap_remove(gap);
+  }
+  if (page->mark && !gap)
+    gtk_text_buffer_delete_mark(page->buffer, page->mark);
+  page->mark = NULL;
+  page->gap = NULL;
+  if (!success) {
+    gdk_threads_leave();
+    return;
+  }
+  /* newest status is where the next poll starts */
+  if (page->first_id && !page->max_id && pollable) {
+    g_free(g_object_get_data(window, "first_status_id"));
+    g_object_set_data(window, "first_status_id", page->first_id);
+    page->first_id = NULL;
+  }
+  /* older statuses, paging position and view are left alone by a poll */
+  if (!page->since_id) {
+    if (page->last_id) {
+      g_free(g_object_get_data(window, "last_status_id"));
+      g_object_set_data(window, "last_status_id", page->last_id);
+      page->last_id = NULL;
+    }
+    g_free(g_object_get_data(window, "timeline_key"));
+    g_object_set_data(window, "timeline_key", page->key);
+    page->key = NULL;
+    gtk_text_buffer_set_modified(page->buffer, FALSE) ;
+    gtk_text_buffer_get_start_iter(page->buffer, &iter);
+    gtk_text_buffer_place_cursor(page->buffer, &iter);
+  }
+  timeline_backfill(page->window);
+  gdk_threads_leave();
 }
 
-static void
-clean_condition() {
-  if (last_condition) g_free(last_condition);
-  last_condition = NULL;
+static HTTP_REQUEST* timeline_request_new(const char* endpoint, const char* url,
+        const char* max_id, const char* since_id, int count);
+
+static gpointer
+timeline_gap_thread(gpointer data) {
+  TIMELINE_GAP* gap = (TIMELINE_GAP*) data;
+  TIMELINE_PAGE page;
+  HTTP_REQUEST* req;
+  JSON_Value* value;
+  gboolean success = FALSE;
+  gchar* since_id;
+  gchar* max_id;
+
+  /* ids of a running gap are only changed by this thread */
+  since_id = g_strdup(gap->since_id);
+  max_id = g_strdup(gap->max_id);
+
+  timeline_page_init(&page, gap->window);
+  page.gap = gap;
+  page.endpoint = gap->endpoint;
+  page.url = gap->url;
+  page.since_id = since_id;
+  page.max_id = max_id;
+  page.limit = POLL_COUNT_MAX;
+
+  req = timeline_request_new(gap->endpoint, gap->url, max_id, since_id, page.limit);
+  if (req) {
+    req->priority = HTTP_PRIORITY_BACKGROUND;
+    http_request_stream_json(req);
+    while ((value = http_request_next_value(req)))
+      timeline_page_add(&page, value);
+    success = req->res == CURLE_OK && req->http_status == 200;
+  }
+  timeline_page_finish(&page, success, FALSE);
+  timeline_page_free(&page);
+  http_request_free(req);
+  g_free(since_id);
+  g_free(max_id);
+  return NULL;
 }
 
+/**
+ * fetch missing statuses of idle gaps, as many side by side as the budget
+ * can spare. gdk lock must be held.
+ */
 static void
-clean_context(GtkWidget* window) {
-  const char* prop_names[] = {
-    "mode", "user_id", "user_name", "status_id",
-    "last_status_id", "page", "in_reply_to_status_id", "search", "tooltip_data",
-    NULL
-  };
-  const char** prop_name = prop_names;
-  while (*prop_name) {
-    gchar* prop_data = g_object_get_data(G_OBJECT(window), *prop_name);
-    if (prop_data) {
-      g_free(prop_data);
-      g_object_set_data(G_OBJECT(window), *prop_name, NULL);
-    }
-    prop_name++;
+timeline_backfill(GtkWidget* window) {
+  GList* gaps = (GList*) g_object_get_data(G_OBJECT(window), "gaps");
+  GList* item;
+  RATE_BUDGET budget;
+  int running = 0;
+  int idle = 0;
+  int spare;
+
+  if (!gaps) return;
+  for (item = gaps; item; item = item->next) {
+    if (((TIMELINE_GAP*) item->data)->running)
+      running++;
+    else
+      idle++;
+  }
+  spare = TIMELINE_BACKFILL_MAX - running;
+  /* polls and posts keep their reserve */
+  if (rate_budget_lookup(((TIMELINE_GAP*) gaps->data)->endpoint, &budget) &&
+          budget.remaining - RATE_LIMIT_RESERVE - running < spare)
+    spare = budget.remaining - RATE_LIMIT_RESERVE - running;
+  if (!idle || spare <= 0) return;
+
+  /* calls to spare go to slices of the first idle gap */
+  for (item = gaps; item; item = item->next) {
+    if (!((TIMELINE_GAP*) item->data)->running) break;
+  }
+  if (spare > idle) timeline_gap_split((TIMELINE_GAP*) item->data, spare - idle + 1);
+
+  for (item = gaps; item && spare > 0; item = item->next) {
+    TIMELINE_GAP* gap = (TIMELINE_GAP*) item->data;
+    if (gap->running) continue;
+    if (!g_thread_create(timeline_gap_thread, gap, FALSE, NULL)) break;
+    gap->running = TRUE;
+    spare--;
   }
-  g_object_set_data(G_OBJECT(window), "tooltip_data", NULL);
 }
 
 /**
- * API limit
+ * timeline stream
+ *
+ * with streaming enabled one long-lived connection to stream_url delivers
+ * new statuses of the home timeline as newline delimited JSON, and each is
+ * put on top as soon as it is parsed. polls pause while the stream is up,
+ * except one to catch up after each (re)connect. a dropped stream is opened
+ * again after a backoff which doubles with each failure in a row.
+ * timeline_stream_stop aborts the connection and waits for the thread.
  */
-static gpointer
-check_ratelimit_thread(gpointer data) {
-  CURL* curl = NULL;
-  CURLcode res = CURLE_OK;
-  long http_status = 0;
-  struct tm localtm = {0};
-  char localdate[256];
-  int remaining_hits = 0;
+typedef struct _TIMELINE_STREAM {
+  GtkWidget* window;
+  gboolean connected;
+  gboolean caught_up;
+  GThread* thread;
+  GMainLoop* loop;      /* runs the engine while stopping */
+  /* under timeline_stream_mutex */
+  gboolean stopped;
+  HTTP_REQUEST* req;    /* current connection */
+  GCond* cond;          /* wakes the backoff up */
+} TIMELINE_STREAM;
+
+static TIMELINE_STREAM timeline_stream = {0};
+static GStaticMutex timeline_stream_mutex = G_STATIC_MUTEX_INIT;
 
-  char* ptr = NULL;
-  char* tmp;
-  char* key;
-  char* query;
-  char* nonce;
-  char* url;
-  char* purl;
-  char auth[21];
-  gpointer result_str = NULL;
-  MEMFILE* mbody = NULL;
-  char* body = NULL;
+static gboolean
+is_home_timeline(GtkWidget* window) {
+  GObject* object = G_OBJECT(window);
+  return !g_object_get_data(object, "mode") &&
+      !g_object_get_data(object, "user_id") &&
+      !g_object_get_data(object, "status_id");
+}
 
-  url = g_strdup(SERVICE_RATE_LIMIT_URL);
+static gboolean
+timeline_stream_skip_poll(GtkWidget* window) {
+  if (!timeline_stream.connected || !is_home_timeline(window)) return FALSE;
+  if (timeline_stream.caught_up) return TRUE;
+  timeline_stream.caught_up = TRUE;
+  return FALSE;
+}
 
-  nonce = get_nonce_alloc();
-  query = g_strdup_printf(
-          "oauth_consumer_key=%s"
-          "&oauth_nonce=%s"
-          "&oauth_request_method=GET"
-          "&oauth_signature_method=HMAC-SHA1"
-          "&oauth_timestamp=%d"
-          "&oauth_token=%s"
-          "&oauth_version=1.0",
-          application_info.consumer_key,
-          nonce,
-          (int) time(0),
-          application_info.access_token);
-  free(nonce);
+static gboolean
+timeline_stream_catch_up(gpointer data) {
+  if (!is_processing) reload_timer_func(data);
+  return FALSE;
+}
 
-  purl = urlencode_alloc(url);
-  ptr = urlencode_alloc(query);
-  tmp = g_strdup_printf("GET&%s&%s", purl, ptr);
-  free(purl);
-  free(ptr);
-  key = g_strdup_printf(
-          "%s&%s",
-          application_info.consumer_secret,
-          application_info.access_token_secret);
-  hmac((unsigned char*) key, strlen(key),
-          (unsigned char*) tmp, strlen(tmp), (unsigned char*) auth);
-  g_free(key);
-  g_free(tmp);
-  tmp = base64encode_alloc(auth, 20);
-  ptr = urlencode_alloc(tmp);
-  free(tmp);
-  tmp = g_strdup_printf("%s&oauth_signature=%s", query, ptr);
-  free(ptr);
-  g_free(query);
-  query = tmp;
-  purl = g_strdup_printf("%s?%s", url, query);
-  g_free(url);
-  url = purl;
-
-  mbody = memfopen();
-  curl = curl_easy_init();
-  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-  curl_easy_setopt(curl, CURLOPT_URL, url);
-  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, mbody);
-  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-  res = curl_easy_perform(curl);
-  if (res == CURLE_OK)
-    curl_easy_getinfo(curl, CURLINFO_HTTP_CODE, &http_status);
-  curl_easy_cleanup(curl);
+/* milliseconds to wait before the next connect, prev is the last wait */
+static guint
+get_stream_backoff(guint prev, CURLcode res, long http_status) {
+  guint first;
+
+  if (res != CURLE_OK)
+    first = STREAM_BACKOFF_NETWORK;
+  else if (http_status == 420 || http_status == 429)
+    first = STREAM_BACKOFF_LIMITED;
+  else if (http_status >= 400)
+    first = STREAM_BACKOFF_HTTP;
+  else
+    first = STREAM_BACKOFF_NETWORK;
+  if (prev < first) return first;
+  return prev * 2 < STREAM_BACKOFF_MAX ? prev * 2 : STREAM_BACKOFF_MAX;
+}
 
-  g_free(url);
+static HTTP_REQUEST*
+stream_request_new(const char* url) {
+  return oauth_request_new(SERVICE_STREAM_URL, "GET", url, NULL, 0);
+}
 
-  body = memfstrdup(mbody);
-  memfclose(mbody);
+static void
+timeline_stream_insert(JSON_Object* tweet) {
+  GtkWidget* window = timeline_stream.window;
+  TIMELINE_PAGE page;
+  gchar* since_id = NULL;
 
-  if (res != CURLE_OK) {
-    goto leave;
-  }
-  if (http_status == 304) {
-    goto leave;
-  }
-  if (http_status != 200) {
-    goto leave;
-  }
+  /* other views and a timeline not loaded yet get it with their next load */
+  gdk_threads_enter();
+  if (is_home_timeline(window))
+    since_id = g_strdup(g_object_get_data(G_OBJECT(window), "first_status_id"));
+  gdk_threads_leave();
+  if (!since_id) return;
+
+  timeline_page_init(&page, window);
+  page.since_id = since_id;
+  timeline_page_insert(&page, tweet);
+  timeline_page_finish(&page, TRUE, TRUE);
+  timeline_page_free(&page);
+  g_free(since_id);
+}
 
-  JSON_Value *root_value = json_parse_string(body);
-  JSON_Object *resources = json_value_get_object(root_value);
-  JSON_Object *application = json_object_dotget_object(resources, "resources.application");
-  JSON_Object *rate_limit_status = json_object_get_object(application, "/application/rate_limit_status");
-  remaining_hits = json_object_get_number(rate_limit_status, "remaining");
-  long times = json_object_get_number(rate_limit_status, "reset");
-  memcpy(&localtm, localtime(&times), sizeof(struct tm));
+static gboolean
+timeline_stream_stopped() {
+  gboolean stopped;
+  g_static_mutex_lock(&timeline_stream_mutex);
+  stopped = timeline_stream.stopped;
+  g_static_mutex_unlock(&timeline_stream_mutex);
+  return stopped;
+}
 
-  strftime(localdate, sizeof(localdate), "%x %X", &localtm);
-  result_str = g_strdup_printf("%d times before %s", remaining_hits, localdate);
+/* current connection, which is cancelled right away once stopped */
+static void
+timeline_stream_set_request(HTTP_REQUEST* req) {
+  g_static_mutex_lock(&timeline_stream_mutex);
+  timeline_stream.req = req;
+  if (req && timeline_stream.stopped) http_request_cancel(req);
+  g_static_mutex_unlock(&timeline_stream_mutex);
+}
 
-leave:
-  if (root_value) json_value_free(root_value);
-  if (body) free(body);
-  return result_str;
+static gboolean
+timeline_stream_done(gpointer data) {
+  g_main_loop_quit(timeline_stream.loop);
+  return FALSE;
 }
 
-static void
-check_ratelimit(GtkWidget* widget, gpointer user_data) {
-  gpointer result;
-  GtkWidget* window = (GtkWidget*) gtk_widget_get_toplevel(widget);
-  GtkWidget* textview = (GtkWidget*) g_object_get_data(G_OBJECT(window), "textview");
-  GtkWidget* toolbox = (GtkWidget*) g_object_get_data(G_OBJECT(window), "toolbox");
-  GtkWidget* statusbar = (GtkWidget*) g_object_get_data(G_OBJECT(window), "statusbar");
-  guint context_id = (guint) g_object_get_data(G_OBJECT(statusbar), "context_id");
+static gpointer
+timeline_stream_thread(gpointer data) {
+  const char* stream_url = application_info.stream_url;
+  gchar* url = g_strdup(stream_url && *stream_url ? stream_url : SERVICE_STREAM_URL);
+  guint backoff = 0;
 
-  if (!application_info.access_token_secret) {
-    if (!setup_dialog(window)) return;
+  while (!timeline_stream_stopped()) {
+    HTTP_REQUEST* req = stream_request_new(url);
+    CURLcode res = CURLE_FAILED_INIT;
+    long http_status = 0;
+    JSON_Value* value;
+    GTimeVal until;
+
+    if (req) {
+      timeline_stream_set_request(req);
+      http_request_stream_lines(req);
+      while ((value = http_request_next_value(req))) {
+        JSON_Object* tweet = json_value_get_object(value);
+        /* values still queued when stopping are dropped */
+        if (timeline_stream_stopped()) {
+          json_value_free(value);
+          continue;
+        }
+        /* first message, the friends list on twitter, proves the stream is up */
+        if (!timeline_stream.connected) {
+          gdk_threads_enter();
+          timeline_stream.connected = TRUE;
+          timeline_stream.caught_up = FALSE;
+          gdk_threads_leave();
+          backoff = 0;
+          g_idle_add(timeline_stream_catch_up, timeline_stream.window);
+        }
+        /* deletes, events and friends lists are not statuses */
+        if (tweet && json_object_get_string(tweet, "id_str") &&
+                json_object_get_string(tweet, "text"))
+          timeline_stream_insert(tweet);
+        json_value_free(value);
+      }
+      res = req->res;
+      http_status = req->http_status;
+      timeline_stream_set_request(NULL);
+      http_request_free(req);
+    }
+
+    gdk_threads_enter();
+    timeline_stream.connected = FALSE;
+    gdk_threads_leave();
+    backoff = get_stream_backoff(backoff, res, http_status);
+    g_get_current_time(&until);
+    g_time_val_add(&until, (glong) backoff * 1000);
+    g_static_mutex_lock(&timeline_stream_mutex);
+    if (!timeline_stream.stopped)
+      g_cond_timed_wait(timeline_stream.cond,
+              g_static_mutex_get_mutex(&timeline_stream_mutex), &until);
+    g_static_mutex_unlock(&timeline_stream_mutex);
   }
+  g_free(url);
+  g_idle_add(timeline_stream_done, NULL);
+  return NULL;
+}
 
-  is_processing = TRUE;
+static void
+timeline_stream_start(GtkWidget* window) {
+  timeline_stream.window = window;
+  timeline_stream.cond = g_cond_new();
+  timeline_stream.thread = g_thread_create(timeline_stream_thread, NULL, TRUE, NULL);
+}
 
-  stop_reload_timer(window);
-  /* disable toolbox */
-  gtk_widget_set_sensitive(toolbox, FALSE);
-  /* set watch cursor at textview */
-  gdk_window_set_cursor(
-          gtk_text_view_get_window(
-              GTK_TEXT_VIEW(textview),
-              GTK_TEXT_WINDOW_TEXT),
-          watch_cursor);
+/* call with the gdk lock held, from the main thread */
+static void
+timeline_stream_stop() {
+  if (!timeline_stream.thread) return;
 
-  gtk_statusbar_pop(GTK_STATUSBAR(statusbar), context_id);
-  result = process_func(check_ratelimit_thread, window, window, _("checking ratelimit..."));
-  if (result) {
-    gtk_statusbar_push(GTK_STATUSBAR(statusbar), context_id, result);
-    g_free(result);
-  }
-  /* enable toolbox */
-  gtk_widget_set_sensitive(toolbox, TRUE);
-  /* set regular cursor at textview */
-  gdk_window_set_cursor(
-          gtk_text_view_get_window(
-              GTK_TEXT_VIEW(textview),
-              GTK_TEXT_WINDOW_TEXT),
-          regular_cursor);
-  start_reload_timer(window);
+  timeline_stream.loop = g_main_loop_new(NULL, FALSE);
+  g_static_mutex_lock(&timeline_stream_mutex);
+  timeline_stream.stopped = TRUE;
+  if (timeline_stream.req) http_request_cancel(timeline_stream.req);
+  g_cond_broadcast(timeline_stream.cond);
+  g_static_mutex_unlock(&timeline_stream_mutex);
 
-  is_processing = FALSE;
+  /* the engine aborts the transfer on this thread, keep it running */
+  gdk_threads_leave();
+  g_main_loop_run(timeline_stream.loop);
+  g_thread_join(timeline_stream.thread);
+  gdk_threads_enter();
+
+  g_main_loop_unref(timeline_stream.loop);
+  timeline_stream.loop = NULL;
+  timeline_stream.thread = NULL;
+  g_cond_free(timeline_stream.cond);
+  timeline_stream.cond = NULL;
 }
 
 /**
@@ -1466,115 +3818,57 @@ check_ratelimit(GtkWidget* widget, gpointer user_data) {
 static gpointer
 search_timeline_thread(gpointer data) {
   GtkWidget* window = (GtkWidget*) data;
-  GtkTextBuffer* buffer = NULL;
-  CURL* curl = NULL;
+  HTTP_REQUEST* req = NULL;
   CURLcode res = CURLE_OK;
   long http_status = 0;
+  gboolean success = FALSE;
+  TIMELINE_PAGE page;
 
   gchar* search = NULL;
   gchar* max_id = NULL;
-  gchar* page = NULL;
+  gchar* last_id = NULL;
   gchar* title = NULL;
 
-  char* ptr = NULL;
-  char* tmp;
-  char* key;
-  char* query;
-  char* nonce;
   char* url;
-  char* purl;
-  char auth[21];
-  char error[CURL_ERROR_SIZE];
+  char count[16];
+  OAUTH_PARAM params[3];
   gpointer result_str = NULL;
-  MEMFILE* mhead = NULL;
-  MEMFILE* mbody = NULL;
   char* body = NULL;
+  gchar* shown_key;
+  JSON_Value* root_value = NULL;
+  JSON_Array* statuses;
   int n;
   int length;
 
-  GtkTextIter iter;
-
-  PIXBUF_CACHE* pixbuf_cache = NULL;
+  timeline_page_init(&page, window);
 
-  url = g_strdup(SERVICE_SEARCH_STATUS_URL);
-
-  nonce = get_nonce_alloc();
-  query = g_strdup_printf(
-          "oauth_consumer_key=%s"
-          "&oauth_nonce=%s"
-          "&oauth_request_method=GET"
-          "&oauth_signature_method=HMAC-SHA1"
-          "&oauth_timestamp=%d"
-          "&oauth_token=%s"
-          "&oauth_version=1.0",
-          application_info.consumer_key,
-          nonce,
-          (int) time(0),
-          application_info.access_token);
-  free(nonce);
+  url = get_api_url_alloc(SERVICE_SEARCH_STATUS_URL);
 
+  last_id = g_object_get_data(G_OBJECT(window), "last_status_id");
+  if (last_id) max_id = get_older_id_alloc(last_id);
   search = g_object_get_data(G_OBJECT(window), "search");
-  tmp = urlencode_alloc(search);
-  ptr = g_strdup_printf("%s&q=%s", query, tmp);
-  free(tmp);
-  g_free(query);
-  query = ptr;
-
-  page = g_object_get_data(G_OBJECT(window), "page");
-  if (page) {
-    char* tmp = g_strdup_printf("%s&page=%s", query, page);
-    g_free(query);
-    query = tmp;
-  }
-
-  purl = urlencode_alloc(url);
-  ptr = urlencode_alloc(query);
-  tmp = g_strdup_printf("GET&%s&%s", purl, ptr);
-  free(purl);
-  free(ptr);
-  key = g_strdup_printf(
-          "%s&%s",
-          application_info.consumer_secret,
-          application_info.access_token_secret);
-  hmac((unsigned char*) key, strlen(key),
-          (unsigned char*) tmp, strlen(tmp), (unsigned char*) auth);
-  g_free(key);
-  g_free(tmp);
-  tmp = base64encode_alloc(auth, 20);
-  ptr = urlencode_alloc(tmp);
-  free(tmp);
-  tmp = g_strdup_printf("%s&oauth_signature=%s", query, ptr);
-  free(ptr);
-  g_free(query);
-  query = tmp;
-  purl = g_strdup_printf("%s?%s", url, query);
-  g_free(url);
-  url = purl;
-
-  mhead = memfopen();
-  mbody = memfopen();
-  curl = curl_easy_init();
-  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error);
-  curl_easy_setopt(curl, CURLOPT_URL, url);
-  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, mbody);
-  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_HEADERDATA, mhead);
-  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-  res = curl_easy_perform(curl);
+  snprintf(count, sizeof(count), "%d", PAGE_COUNT);
+  params[0].name = "count";  params[0].value = count;
+  params[1].name = "max_id"; params[1].value = max_id;
+  params[2].name = "q";      params[2].value = search;
+  req = oauth_request_new(SERVICE_SEARCH_STATUS_URL, "GET", url, params, 3);
+  page.key = get_request_key_alloc("GET", req ? req->url : url, NULL);
+  shown_key = g_object_get_data(G_OBJECT(window), "timeline_key");
+  if (req) http_request_set_conditional(req, shown_key && !strcmp(shown_key, page.key));
+  res = http_request_perform(req);
   if (res == CURLE_OK)
-    curl_easy_getinfo(curl, CURLINFO_HTTP_CODE, &http_status);
-  curl_easy_cleanup(curl);
+    http_status = req->http_status;
 
   g_free(url);
-  body = memfstrdup(mbody);
-  memfclose(mbody);
+  if (req) body = memfdetach(req->body);
+
+  if (res == CURLE_OK) {
+    http_last_refresh = req->timing;
+    http_last_refresh_endpoint = req->endpoint;
+  }
 
   if (res != CURLE_OK) {
-    result_str = g_strdup(error);
+    result_str = g_strdup(req ? req->error : curl_easy_strerror(res));
     goto leave;
   }
   if (http_status == 304) {
@@ -1590,194 +3884,27 @@ search_timeline_thread(gpointer data) {
   }
 
   title = g_strdup_printf("%s - Search \"%s\"", APP_TITLE, search);
-  gtk_window_set_title(GTK_WINDOW(window), title);
-  g_free(title);
-
-  gdk_threads_enter();
-  buffer = (GtkTextBuffer*) g_object_get_data(G_OBJECT(window), "buffer");
-  if (max_id || page) {
-    gtk_text_buffer_get_end_iter(buffer, &iter);
-  } else {
-    gtk_text_buffer_set_text(buffer, "", 0);
-    gtk_text_buffer_get_iter_at_mark(buffer, &iter, gtk_text_buffer_get_insert(buffer));
-  }
-  gdk_threads_leave();
+  page.title = title;
+  page.max_id = max_id;
 
-  JSON_Value *root_value = json_parse_string(body);
-  JSON_Object *root = json_value_get_object(root_value);
-  JSON_Array *statuses = json_object_get_array(root, "statuses");
-
-  /* allocate pixbuf cache buffer */
-  length = json_array_get_count(statuses);
-  pixbuf_cache = malloc(length*sizeof(PIXBUF_CACHE));
-  memset(pixbuf_cache, 0, length*sizeof(PIXBUF_CACHE));
+  root_value = json_parse_string(body);
+  statuses = json_object_get_array(json_value_get_object(root_value), "statuses");
 
   /* make timeline */
+  length = json_array_get_count(statuses);
   for(n = 0; n < length; n++) {
-    const char* id = NULL;
-    const char* user_id = NULL;
-    const char* icon = NULL;
-    const char* real = NULL;
-    const char* user_name = NULL;
-    const char* text = NULL;
-    const char* date = NULL;
-    int favorited = 0;
-    int retweeted = 0;
-    GdkPixbuf* pixbuf = NULL;
-    GtkTextTag* tag = NULL;
-    struct tm localtm;
-    char localdate[256];
-    int cache;
-
     JSON_Object *tweet = json_array_get_object(statuses, n);
-
-    /* status nodes */
-    id = json_object_dotget_string(tweet, "id");
-    date = json_object_dotget_string(tweet, "created_at");
-    text = json_object_dotget_string(tweet, "text");
-    favorited = json_object_dotget_boolean(tweet, "favorited");
-    retweeted = json_object_dotget_boolean(tweet, "retweeted");
-    user_id = json_object_dotget_string(tweet, "user.id");
-    real = json_object_dotget_string(tweet, "user.name");
-    user_name = json_object_dotget_string(tweet, "user.screen_name");
-    icon = json_object_dotget_string(tweet, "user.profile_image_url");
-
-    /**
-     * avoid to duplicate downloading of icon.
-     */
-    for(cache = 0; cache < length; cache++) {
-      if (!pixbuf_cache[cache].user_id) break;
-      if (!strcmp(pixbuf_cache[cache].user_id, user_id)) {
-        pixbuf = pixbuf_cache[cache].pixbuf;
-        break;
-      }
-    }
-    if (!pixbuf) {
-      pixbuf = url2pixbuf((char*) icon, NULL);
-      if (pixbuf) {
-        pixbuf_cache[cache].user_id = user_id;
-        pixbuf_cache[cache].pixbuf = pixbuf;
-      }
-    }
-
-    /**
-     * layout:
-     *
-     * [icon] [name:name_tag]
-     * [message]
-     * [date:date_tag]
-     *
-     */
-    gdk_threads_enter();
-    if (pixbuf) {
-      GdkPixbuf* tmp = gdk_pixbuf_scale_simple(pixbuf, 32, 32, GDK_INTERP_TILES);
-      if (tmp) pixbuf = tmp;
-      gtk_text_buffer_insert_pixbuf(buffer, &iter, pixbuf);
-    }
-    gtk_text_buffer_insert(buffer, &iter, " ", -1);
-
-    tag = gtk_text_buffer_create_tag(
-            buffer,
-            NULL,
-            "scale",
-            PANGO_SCALE_LARGE,
-            "underline",
-            PANGO_UNDERLINE_SINGLE,
-            "weight",
-            PANGO_WEIGHT_BOLD,
-            "foreground",
-            "#0000FF",
-            NULL);
-    g_object_set_data(G_OBJECT(tag), "user_id", g_strdup(user_id));
-    g_object_set_data(G_OBJECT(tag), "user_name", g_strdup(user_name));
-    gtk_text_buffer_insert_with_tags(buffer, &iter, user_name, -1, tag, NULL);
-    gtk_text_buffer_insert(buffer, &iter, " (", -1);
-    gtk_text_buffer_insert(buffer, &iter, real, -1);
-    gtk_text_buffer_insert(buffer, &iter, ")\n", -1);
-    insert_status_text(buffer, &iter, text);
-    gtk_text_buffer_insert(buffer, &iter, "\n", -1);
-
-    tweettime_to_time(&localtm, date);
-    strftime(localdate, sizeof(localdate), "%x %X", &localtm);
-
-    tag = gtk_text_buffer_create_tag(
-            buffer,
-            NULL,
-            "scale",
-            PANGO_SCALE_X_SMALL,
-            "style",
-            PANGO_STYLE_ITALIC,
-            "foreground",
-            "#005500",
-            NULL);
-    g_object_set_data(G_OBJECT(tag), "status_url", g_strdup_printf(SERVICE_STATUS_URL, user_name, id));
-    gtk_text_buffer_insert_with_tags(buffer, &iter, localdate, -1, tag, NULL);
-
-    gtk_text_buffer_insert(buffer, &iter, " ", -1);
-
-    tag = gtk_text_buffer_create_tag(
-            buffer,
-            NULL,
-            "scale",
-            PANGO_SCALE_X_SMALL,
-            "style",
-            PANGO_STYLE_ITALIC,
-            "foreground",
-            "#000055",
-            NULL);
-    g_object_set_data(G_OBJECT(tag), "reply", g_strdup(user_name));
-    g_object_set_data(G_OBJECT(tag), "in_reply_to_status_id", g_strdup(id));
-    gtk_text_buffer_insert_with_tags(buffer, &iter, "reply", -1, tag, NULL);
-
-    gtk_text_buffer_insert(buffer, &iter, " ", -1);
-
-    tag = gtk_text_buffer_create_tag(
-            buffer,
-            NULL,
-            "scale",
-            PANGO_SCALE_X_SMALL,
-            "style",
-            PANGO_STYLE_ITALIC,
-            "foreground",
-            retweeted ? "#555555" : "#000055",
-            NULL);
-    g_object_set_data(G_OBJECT(tag), "retweet", g_strdup_printf((retweeted ? "-%s" : "%s"), id));
-    gtk_text_buffer_insert_with_tags(buffer, &iter, "retweet", -1, tag, NULL);
-
-    gtk_text_buffer_insert(buffer, &iter, " ", -1);
-
-    tag = gtk_text_buffer_create_tag(
-            buffer,
-            NULL,
-            "scale",
-            PANGO_SCALE_X_SMALL,
-            "style",
-            PANGO_STYLE_ITALIC,
-            "foreground",
-            favorited ? "#555555" : "#000055",
-            NULL);
-    g_object_set_data(G_OBJECT(tag), "favorite", g_strdup_printf((favorited ? "-%s" : "%s"), id));
-    gtk_text_buffer_insert_with_tags(buffer, &iter, "favorite", -1, tag, NULL);
-
-    gtk_text_buffer_insert(buffer, &iter, "\n\n", -1);
-
-    if (n == length - 1) {
-      gchar* old_data = g_object_get_data(G_OBJECT(window), "last_status_id");
-      if (old_data) g_free(old_data);
-      g_object_set_data(G_OBJECT(window), "last_status_id", g_strdup(id));
-    }
-
-    gdk_threads_leave();
+    if (tweet) timeline_page_insert(&page, tweet);
   }
-  free(pixbuf_cache);
-
-  gdk_threads_enter();
-  gtk_text_buffer_set_modified(buffer, FALSE) ;
-  gtk_text_buffer_get_start_iter(buffer, &iter);
-  gtk_text_buffer_place_cursor(buffer, &iter);
-  gdk_threads_leave();
+  success = TRUE;
 
 leave:
+  /* search is reloaded as a whole, it isn't polled */
+  timeline_page_finish(&page, success, FALSE);
+  timeline_page_free(&page);
+  g_free(max_id);
+  g_free(title);
+  http_request_free(req);
   if (root_value) json_value_free(root_value);
   if (body) free(body);
   return result_str;
@@ -1788,7 +3915,7 @@ search_timeline(GtkWidget* widget, gpointer user_data) {
   gpointer result;
   GtkWidget* window = (GtkWidget*) gtk_widget_get_toplevel(widget);
   GtkWidget* textview = (GtkWidget*) g_object_get_data(G_OBJECT(window), "textview");
-  GtkWidget* toolbox = (GtkWidget*) g_object_get_data(G_OBJECT(window), "toolbox");
+  GtkWidget* buttonbox = (GtkWidget*) g_object_get_data(G_OBJECT(window), "buttonbox");
 
   if (!application_info.access_token_secret) {
     if (!setup_dialog(window)) return;
@@ -1797,8 +3924,8 @@ search_timeline(GtkWidget* widget, gpointer user_data) {
   is_processing = TRUE;
 
   stop_reload_timer(window);
-  /* disable toolbox */
-  gtk_widget_set_sensitive(toolbox, FALSE);
+  /* disable buttons, posting is still possible while refreshing */
+  gtk_widget_set_sensitive(buttonbox, FALSE);
   /* set watch cursor at textview */
   gdk_window_set_cursor(
           gtk_text_view_get_window(
@@ -1811,8 +3938,9 @@ search_timeline(GtkWidget* widget, gpointer user_data) {
     error_dialog(window, result);
     g_free(result);
   }
-  /* enable toolbox */
-  gtk_widget_set_sensitive(toolbox, TRUE);
+  update_statusbar(window);
+  /* enable buttons */
+  gtk_widget_set_sensitive(buttonbox, TRUE);
   /* set regular cursor at textview */
   gdk_window_set_cursor(
           gtk_text_view_get_window(
@@ -1824,181 +3952,97 @@ search_timeline(GtkWidget* widget, gpointer user_data) {
   is_processing = FALSE;
 }
 
+/**
+ * signed request of a home, mentions, user or thread timeline page
+ */
+static HTTP_REQUEST*
+timeline_request_new(const char* endpoint, const char* url,
+        const char* max_id, const char* since_id, int count) {
+  char number[16];
+  OAUTH_PARAM params[5];
+
+  snprintf(number, sizeof(number), "%d", count);
+  params[0].name = "count";       params[0].value = number;
+  params[1].name = "include_rts"; params[1].value = "true";
+  params[2].name = "max_id";      params[2].value = max_id;
+  params[3].name = "since_id";    params[3].value = since_id;
+  /* authors come from the user store */
+  params[4].name = "trim_user";   params[4].value = "true";
+  return oauth_request_new(endpoint, "GET", url, params, 5);
+}
+
 /**
  * update home statuses
  */
 static gpointer
 update_timeline_thread(gpointer data) {
   GtkWidget* window = (GtkWidget*) data;
-  GtkTextBuffer* buffer = NULL;
-  CURL* curl = NULL;
+  HTTP_REQUEST* req = NULL;
   CURLcode res = CURLE_OK;
-  struct curl_slist* headers = NULL;
   long http_status = 0;
+  gboolean success = FALSE;
+  TIMELINE_PAGE page;
 
   gchar* mode = NULL;
   gchar* max_id = NULL;
-  gchar* page = NULL;
+  gchar* since_id = NULL;
   gchar* user_id = NULL;
   gchar* user_name = NULL;
   gchar* status_id = NULL;
   gchar* title = NULL;
 
-  char* ptr = NULL;
-  char* tmp;
-  char* key;
-  char* query;
   char* url;
-  char* purl;
-  char* nonce;
-  char auth[21];
-  char error[CURL_ERROR_SIZE];
+  const char* endpoint;
   gpointer result_str = NULL;
-  MEMFILE* mhead;
-  MEMFILE* mbody;
-  char* body;
-  char* head;
-  int n;
-  int length;
-  char* cond;
-
-  GtkTextIter iter;
+  char* body = NULL;
+  gchar* shown_key;
+  JSON_Value* value;
 
-  PIXBUF_CACHE* pixbuf_cache = NULL;
+  timeline_page_init(&page, window);
 
   mode = g_object_get_data(G_OBJECT(window), "mode");
   if (mode && !strcmp(mode, "replies")) {
-    url = g_strdup(SERVICE_REPLIES_STATUS_URL);
+    endpoint = SERVICE_REPLIES_STATUS_URL;
+    url = get_api_url_alloc(endpoint);
   } else {
     user_id = g_object_get_data(G_OBJECT(window), "user_id");
     user_name = g_object_get_data(G_OBJECT(window), "user_name");
     status_id = g_object_get_data(G_OBJECT(window), "status_id");
     if (status_id) {
-      url = g_strdup_printf(SERVICE_THREAD_STATUS_URL, status_id);
-      /* status_id is temporary value */
-      g_free(status_id);
-      g_object_set_data(G_OBJECT(window), "status_id", NULL);
-    }
-    else
-      if (user_id)
-        url = g_strdup_printf(SERVICE_USER_STATUS_URL, user_id);
-      else
-        url = g_strdup(SERVICE_HOME_STATUS_URL);
-  }
-
-  nonce = get_nonce_alloc();
-  query = g_strdup_printf(
-          "oauth_consumer_key=%s"
-          "&oauth_nonce=%s"
-          "&oauth_request_method=GET"
-          "&oauth_signature_method=HMAC-SHA1"
-          "&oauth_timestamp=%d"
-          "&oauth_token=%s"
-          "&oauth_version=1.0",
-          application_info.consumer_key,
-          nonce,
-          (int) time(0),
-          application_info.access_token);
-  free(nonce);
-
-  max_id = g_object_get_data(G_OBJECT(window), "last_status_id");
-  if (max_id) {
-    ptr = g_strdup_printf("max_id=%s&%s", max_id, query);
-    g_free(query);
-    query = ptr;
-  } else {
-    page = g_object_get_data(G_OBJECT(window), "page");
-    if (page) {
-      ptr = g_strdup_printf("%s&page=%s", query, page);
-      g_free(query);
-      query = ptr;
-    }
-  }
-
-  ptr = g_strdup_printf("include_rts=true&%s", query);
-  g_free(query);
-  query = ptr;
-
-  purl = urlencode_alloc(url);
-  ptr = urlencode_alloc(query);
-  tmp = g_strdup_printf("GET&%s&%s", purl, ptr);
-  free(purl);
-  free(ptr);
-  key = g_strdup_printf(
-          "%s&%s",
-          application_info.consumer_secret,
-          application_info.access_token_secret);
-  hmac((unsigned char*) key, strlen(key),
-          (unsigned char*) tmp, strlen(tmp), (unsigned char*) auth);
-  g_free(key);
-  g_free(tmp);
-  tmp = base64encode_alloc(auth, 20);
-  ptr = urlencode_alloc(tmp);
-  tmp = g_strdup_printf("%s&oauth_signature=%s", query, ptr);
-  free(ptr);
-  g_free(query);
-  query = tmp;
-  purl = g_strdup_printf("%s?%s", url, query);
-  g_free(url);
-  url = purl;
-
-  mhead = memfopen();
-  mbody = memfopen();
-  curl = curl_easy_init();
-  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error);
-  curl_easy_setopt(curl, CURLOPT_URL, url);
-  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, mbody);
-  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_HEADERDATA, mhead);
-  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-  if (last_condition) {
-    headers = curl_slist_append(headers, last_condition);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-  }
-  res = curl_easy_perform(curl);
-  if (res == CURLE_OK)
-    curl_easy_getinfo(curl, CURLINFO_HTTP_CODE, &http_status);
-  curl_easy_cleanup(curl);
-
-  g_free(query);
-  g_free(url);
-  head = memfstrdup(mhead);
-  memfclose(mhead);
-  body = memfstrdup(mbody);
-  memfclose(mbody);
-
-  if (res != CURLE_OK) {
-    result_str = g_strdup(error);
-    goto leave;
-  }
-  if (http_status == 304) {
-    goto leave;
-  }
-  if (http_status != 200) {
-    if (body) {
-      result_str = g_strdup(body);
-    } else {
-      result_str = g_strdup(_("unknown server response"));
+      endpoint = SERVICE_THREAD_STATUS_URL;
+      url = get_api_url_alloc(endpoint, status_id);
     }
-    goto leave;
+    else
+      if (user_id) {
+        endpoint = SERVICE_USER_STATUS_URL;
+        url = get_api_url_alloc(endpoint, user_id);
+      } else {
+        endpoint = SERVICE_HOME_STATUS_URL;
+        url = get_api_url_alloc(endpoint);
+      }
   }
 
-  cond = get_http_header_alloc(head, "ETag");
-  if (cond) {
-    clean_condition();
-    last_condition = g_strdup_printf("If-None-Match: %s", cond);
+  /* since_id is temporary value, set by reload_timer_func */
+  since_id = g_object_get_data(G_OBJECT(window), "since_id");
+  if (since_id) {
+    g_object_set_data(G_OBJECT(window), "since_id", NULL);
   } else {
-    cond = get_http_header_alloc(head, "Last-Modified");
-    if (cond) {
-      clean_condition();
-      last_condition = g_strdup_printf("If-None-Match: %s", cond);
-    }
+    /* next page starts right below the oldest status shown */
+    gchar* last_id = g_object_get_data(G_OBJECT(window), "last_status_id");
+    if (last_id) max_id = get_older_id_alloc(last_id);
+  }
+  page.limit = since_id ? get_poll_count(endpoint) : PAGE_COUNT;
+
+  req = timeline_request_new(endpoint, url, max_id, since_id, page.limit);
+  if (!req) {
+    result_str = g_strdup(curl_easy_strerror(CURLE_FAILED_INIT));
+    goto leave;
   }
-  if (cond) free(cond);
+  /* a 304 only means nothing to do when the same response is shown */
+  page.key = get_request_key_alloc(req->method, req->url, NULL);
+  shown_key = g_object_get_data(G_OBJECT(window), "timeline_key");
+  http_request_set_conditional(req,
+          since_id || (shown_key && !strcmp(shown_key, page.key)));
 
   if (mode && !strcmp(mode, "replies"))
     title = g_strdup_printf("%s - Replies", APP_TITLE);
@@ -2010,203 +4054,53 @@ update_timeline_thread(gpointer data) {
         title = g_strdup_printf("%s - (%s)", APP_TITLE, user_id);
       else
         title = g_strdup(APP_TITLE);
-  gtk_window_set_title(GTK_WINDOW(window), title);
-  g_free(title);
+  page.title = title;
+  page.endpoint = endpoint;
+  page.url = url;
+  page.max_id = max_id;
+  page.since_id = since_id;
+
+  /* render each status as soon as parser completes it */
+  http_request_stream_json(req);
+  while ((value = http_request_next_value(req)))
+    timeline_page_add(&page, value);
+  res = req->res;
+  if (res == CURLE_OK)
+    http_status = req->http_status;
+  body = memfdetach(req->body);
 
-  gdk_threads_enter();
-  buffer = (GtkTextBuffer*) g_object_get_data(G_OBJECT(window), "buffer");
-  if (max_id || page) {
-    gtk_text_buffer_get_end_iter(buffer, &iter);
-  } else {
-    gtk_text_buffer_set_text(buffer, "", 0);
-    gtk_text_buffer_get_iter_at_mark(buffer, &iter, gtk_text_buffer_get_insert(buffer));
+  if (res == CURLE_OK) {
+    http_last_refresh = req->timing;
+    http_last_refresh_endpoint = req->endpoint;
   }
-  gdk_threads_leave();
-
-  JSON_Value *root_value = json_parse_string(body);
-  JSON_Array *tweets = json_value_get_array(root_value);
-
-  /* allocate pixbuf cache buffer */
-  length = json_array_get_count(tweets);
-  pixbuf_cache = malloc(length*sizeof(PIXBUF_CACHE));
-  memset(pixbuf_cache, 0, length*sizeof(PIXBUF_CACHE));
-
-  /* make timeline */
-  for(n = 0; n < length; n++) {
-    const char* id = NULL;
-    const char* user_id = NULL;
-    const char* icon = NULL;
-    const char* real = NULL;
-    const char* user_name = NULL;
-    const char* text = NULL;
-    const char* date = NULL;
-    int favorited = 0;
-    int retweeted = 0;
-    GdkPixbuf* pixbuf = NULL;
-    GtkTextTag* tag = NULL;
-    struct tm localtm;
-    char localdate[256];
-    int cache;
-
-    JSON_Object *tweet = json_array_get_object(tweets, n);
-
-    /* status nodes */
-    id = json_object_dotget_string(tweet, "id");
-    date = json_object_dotget_string(tweet, "created_at");
-    text = json_object_dotget_string(tweet, "text");
-    favorited = json_object_dotget_boolean(tweet, "favorited");
-    retweeted = json_object_dotget_boolean(tweet, "retweeted");
-    user_id = json_object_dotget_string(tweet, "user.id");
-    real = json_object_dotget_string(tweet, "user.name");
-    user_name = json_object_dotget_string(tweet, "user.screen_name");
-    icon = json_object_dotget_string(tweet, "user.profile_image_url");
-
-    /* skip duplicate status in previous/current. */
-    if (max_id && !strcmp(id, max_id)) {
-      continue;
-    }
-
-    /**
-     * avoid to duplicate downloading of icon.
-     */
-    for(cache = 0; cache < length; cache++) {
-      if (!pixbuf_cache[cache].user_id) break;
-      if (!strcmp(pixbuf_cache[cache].user_id, user_id)) {
-        pixbuf = pixbuf_cache[cache].pixbuf;
-        break;
-      }
-    }
-    if (!pixbuf) {
-      pixbuf = url2pixbuf((char*) icon, NULL);
-      if (pixbuf) {
-        pixbuf_cache[cache].user_id = user_id;
-        pixbuf_cache[cache].pixbuf = pixbuf;
-      }
-    }
 
-    /**
-     * layout:
-     *
-     * [icon] [name:name_tag]
-     * [message]
-     * [date:date_tag]
-     *
-     */
-    gdk_threads_enter();
-    if (pixbuf) {
-      GdkPixbuf* tmp = gdk_pixbuf_scale_simple(pixbuf, 32, 32, GDK_INTERP_TILES);
-      if (tmp) pixbuf = tmp;
-      gtk_text_buffer_insert_pixbuf(buffer, &iter, pixbuf);
-    }
-    gtk_text_buffer_insert(buffer, &iter, " ", -1);
-
-    tag = gtk_text_buffer_create_tag(
-            buffer,
-            NULL,
-            "scale",
-            PANGO_SCALE_LARGE,
-            "underline",
-            PANGO_UNDERLINE_SINGLE,
-            "weight",
-            PANGO_WEIGHT_BOLD,
-            "foreground",
-            "#0000FF",
-            NULL);
-    g_object_set_data(G_OBJECT(tag), "user_id", g_strdup(user_id));
-    g_object_set_data(G_OBJECT(tag), "user_name", g_strdup(user_name));
-    gtk_text_buffer_insert_with_tags(buffer, &iter, user_name, -1, tag, NULL);
-    gtk_text_buffer_insert(buffer, &iter, " (", -1);
-    gtk_text_buffer_insert(buffer, &iter, real, -1);
-    gtk_text_buffer_insert(buffer, &iter, ")\n", -1);
-    insert_status_text(buffer, &iter, text);
-    gtk_text_buffer_insert(buffer, &iter, "\n", -1);
-
-    tweettime_to_time(&localtm, date);
-    strftime(localdate, sizeof(localdate), "%x %X", &localtm);
-
-    tag = gtk_text_buffer_create_tag(
-            buffer,
-            NULL,
-            "scale",
-            PANGO_SCALE_X_SMALL,
-            "style",
-            PANGO_STYLE_ITALIC,
-            "foreground",
-            "#005500",
-            NULL);
-    g_object_set_data(G_OBJECT(tag), "status_url", g_strdup_printf(SERVICE_STATUS_URL, user_name, id));
-    gtk_text_buffer_insert_with_tags(buffer, &iter, localdate, -1, tag, NULL);
-
-    // reply
-    gtk_text_buffer_insert(buffer, &iter, " ", -1);
-
-    tag = gtk_text_buffer_create_tag(
-            buffer,
-            NULL,
-            "scale",
-            PANGO_SCALE_X_SMALL,
-            "style",
-            PANGO_STYLE_ITALIC,
-            "foreground",
-            "#000055",
-            NULL);
-    g_object_set_data(G_OBJECT(tag), "reply", g_strdup(user_name));
-    g_object_set_data(G_OBJECT(tag), "in_reply_to_status_id", g_strdup(id));
-    gtk_text_buffer_insert_with_tags(buffer, &iter, "reply", -1, tag, NULL);
-
-    // retweet
-    gtk_text_buffer_insert(buffer, &iter, " ", -1);
-
-    tag = gtk_text_buffer_create_tag(
-            buffer,
-            NULL,
-            "scale",
-            PANGO_SCALE_X_SMALL,
-            "style",
-            PANGO_STYLE_ITALIC,
-            "foreground",
-            retweeted ? "#555555" : "#000055",
-            NULL);
-    g_object_set_data(G_OBJECT(tag), "retweet", g_strdup_printf((retweeted ? "-%s" : "%s"), id));
-    gtk_text_buffer_insert_with_tags(buffer, &iter, "retweet", -1, tag, NULL);
-
-    // favorite
-    gtk_text_buffer_insert(buffer, &iter, " ", -1);
-
-    tag = gtk_text_buffer_create_tag(
-            buffer,
-            NULL,
-            "scale",
-            PANGO_SCALE_X_SMALL,
-            "style",
-            PANGO_STYLE_ITALIC,
-            "foreground",
-            favorited ? "#555555" : "#000055",
-            NULL);
-    g_object_set_data(G_OBJECT(tag), "favorite", g_strdup_printf((favorited ? "-%s" : "%s"), id));
-    gtk_text_buffer_insert_with_tags(buffer, &iter, "favorite", -1, tag, NULL);
-
-    gtk_text_buffer_insert(buffer, &iter, "\n\n", -1);
-
-    if (n == length - 1) {
-      gchar* old_data = g_object_get_data(G_OBJECT(window), "last_status_id");
-      if (old_data) g_free(old_data);
-      g_object_set_data(G_OBJECT(window), "last_status_id", g_strdup(id));
+  if (res != CURLE_OK) {
+    result_str = g_strdup(req->error);
+    goto leave;
+  }
+  if (http_status == 304) {
+    goto leave;
+  }
+  if (http_status != 200) {
+    if (body) {
+      result_str = g_strdup(body);
+    } else {
+      result_str = g_strdup(_("unknown server response"));
     }
-
-    gdk_threads_leave();
+    goto leave;
   }
-  free(pixbuf_cache);
 
-  gdk_threads_enter();
-  gtk_text_buffer_set_modified(buffer, FALSE) ;
-  gtk_text_buffer_get_start_iter(buffer, &iter);
-  gtk_text_buffer_place_cursor(buffer, &iter);
-  gdk_threads_leave();
+  success = TRUE;
 
 leave:
-  if (root_value) json_value_free(root_value);
-  if (head) free(head);
+  /* thread view has nothing to poll */
+  timeline_page_finish(&page, success, !status_id);
+  timeline_page_free(&page);
+  http_request_free(req);
+  g_free(url);
+  g_free(max_id);
+  g_free(since_id);
+  g_free(title);
   if (body) free(body);
   return result_str;
 }
@@ -2216,7 +4110,7 @@ update_timeline(GtkWidget* widget, gpointer user_data) {
   gpointer result;
   GtkWidget* window = (GtkWidget*) gtk_widget_get_toplevel(widget);
   GtkWidget* textview = (GtkWidget*) g_object_get_data(G_OBJECT(window), "textview");
-  GtkWidget* toolbox = (GtkWidget*) g_object_get_data(G_OBJECT(window), "toolbox");
+  GtkWidget* buttonbox = (GtkWidget*) g_object_get_data(G_OBJECT(window), "buttonbox");
   GtkWidget* entry = (GtkWidget*) g_object_get_data(G_OBJECT(window), "entry");
 
   if (!application_info.access_token_secret) {
@@ -2226,8 +4120,8 @@ update_timeline(GtkWidget* widget, gpointer user_data) {
   is_processing = TRUE;
 
   stop_reload_timer(window);
-  /* disable toolbox */
-  gtk_widget_set_sensitive(toolbox, FALSE);
+  /* disable buttons, posting is still possible while refreshing */
+  gtk_widget_set_sensitive(buttonbox, FALSE);
   /* set watch cursor at textview */
   gdk_window_set_cursor(
           gtk_text_view_get_window(
@@ -2240,8 +4134,9 @@ update_timeline(GtkWidget* widget, gpointer user_data) {
     error_dialog(window, result);
     g_free(result);
   }
-  /* enable toolbox */
-  gtk_widget_set_sensitive(toolbox, TRUE);
+  update_statusbar(window);
+  /* enable buttons */
+  gtk_widget_set_sensitive(buttonbox, TRUE);
   /* set regular cursor at textview */
   gdk_window_set_cursor(
           gtk_text_view_get_window(
@@ -2276,88 +4171,31 @@ replies_timeline(GtkWidget* widget, gpointer user_data) {
 static gpointer
 retweet_status_thread(gpointer data) {
   GtkWidget* window = (GtkWidget*) data;
-  CURL* curl = NULL;
+  HTTP_REQUEST* req = NULL;
   CURLcode res = CURLE_OK;
   long http_status = 0;
 
   char* status_id = NULL;
 
-  char* ptr = NULL;
-  char* tmp;
-  char* key;
-  char* query;
-  char* nonce;
   char* url;
-  char* purl;
-  char auth[21];
-  char error[CURL_ERROR_SIZE];
   gpointer result_str = NULL;
-  MEMFILE* mbody;
-  char* body;
+  char* body = NULL;
 
   gdk_threads_enter();
   status_id = g_object_get_data(G_OBJECT(window), "retweet");
   gdk_threads_leave();
 
   if (!status_id || strlen(status_id) == 0) return NULL;
-  url = g_strdup_printf(SERVICE_RETWEET_URL, status_id);
-
-  nonce = get_nonce_alloc();
-  query = g_strdup_printf(
-          "oauth_consumer_key=%s"
-          "&oauth_nonce=%s"
-          "&oauth_request_method=POST"
-          "&oauth_signature_method=HMAC-SHA1"
-          "&oauth_timestamp=%d"
-          "&oauth_token=%s"
-          "&oauth_version=1.0",
-          application_info.consumer_key,
-          nonce,
-          (int) time(0),
-          application_info.access_token);
-  free(nonce);
+  url = get_api_url_alloc(SERVICE_RETWEET_URL, status_id);
 
-  purl = urlencode_alloc(url);
-  ptr = urlencode_alloc(query);
-  tmp = g_strdup_printf("POST&%s&%s", purl, ptr);
-  free(purl);
-  free(ptr);
-  key = g_strdup_printf(
-          "%s&%s",
-          application_info.consumer_secret,
-          application_info.access_token_secret);
-  hmac((unsigned char*) key, strlen(key),
-          (unsigned char*) tmp, strlen(tmp), (unsigned char*) auth);
-  g_free(key);
-  g_free(tmp);
-  tmp = base64encode_alloc(auth, 20);
-  ptr = urlencode_alloc(tmp);
-  free(tmp);
-  tmp = g_strdup_printf("%s&oauth_signature=%s", query, ptr);
-  free(ptr);
-  g_free(query);
-  query = tmp;
-
-  mbody = memfopen();
-  curl = curl_easy_init();
-  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error);
-  curl_easy_setopt(curl, CURLOPT_URL, url);
-  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_POST, 1);
-  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, query);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, mbody);
-  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-  res = curl_easy_perform(curl);
+  req = oauth_request_new(SERVICE_RETWEET_URL, "POST", url, NULL, 0);
+  res = http_request_perform(req);
   if (res == CURLE_OK)
-    curl_easy_getinfo(curl, CURLINFO_HTTP_CODE, &http_status);
-  curl_easy_cleanup(curl);
+    http_status = req->http_status;
 
-  g_free(query);
-  body = memfstrdup(mbody);
-  memfclose(mbody);
+  g_free(url);
+  if (req) body = memfdetach(req->body);
+  http_request_free(req);
   if (http_status != 200) {
     if (body) {
       result_str = g_strdup(body);
@@ -2405,8 +4243,6 @@ retweet_status(GtkWidget* widget, GtkTextTag* tag) {
     else
       g_object_set_data(G_OBJECT(tag), "retweet", g_strdup(status_id+1));
     g_free(status_id);
-
-    clean_condition();
   }
   if (result) {
     /* show error message */
@@ -2427,223 +4263,190 @@ retweet_status(GtkWidget* widget, GtkTextTag* tag) {
   update_timeline(window, NULL);
 }
 
+/**
+ * hover cards
+ *
+ * profile of a user or expanded url, shown as the tooltip of the link under
+ * the pointer. the lookup runs on a thread of its own without is_processing,
+ * so the timeline stays usable, and is cancelled along with its request
+ * once the pointer leaves the link.
+ */
+typedef struct _HOVER {
+  GtkWidget* window;
+  gchar* data; /* "url:..." or "user:..." as in tooltip_data */
+  HTTP_REQUEST* req;
+  gboolean cancelled;
+  gchar* result;
+} HOVER;
+
+/* guards req and cancelled of every hover */
+static GStaticMutex hover_mutex = G_STATIC_MUTEX_INIT;
+
+/* req is about to be performed for hover, FALSE if it was cancelled already */
+static gboolean
+hover_set_request(HOVER* hover, HTTP_REQUEST* req) {
+  gboolean cancelled;
+
+  g_static_mutex_lock(&hover_mutex);
+  cancelled = hover->cancelled;
+  hover->req = cancelled ? NULL : req;
+  g_static_mutex_unlock(&hover_mutex);
+  return !cancelled;
+}
+
+static void
+hover_cancel(HOVER* hover) {
+  g_static_mutex_lock(&hover_mutex);
+  hover->cancelled = TRUE;
+  if (hover->req) http_request_cancel(hover->req);
+  g_static_mutex_unlock(&hover_mutex);
+}
+
+/* cancels the hover card of window, if one is being looked up */
+static void
+hover_stop(GtkWidget* window) {
+  HOVER* hover = (HOVER*) g_object_get_data(G_OBJECT(window), "hover");
+  if (!hover) return;
+  hover_cancel(hover);
+  g_object_set_data(G_OBJECT(window), "hover", NULL);
+}
+
 /**
  * user profile
  */
 static gpointer
 user_profile_thread(gpointer data) {
-  CURL* curl = NULL;
-  char* ptr = NULL;
-  char* tmp;
-  char* key;
-  char* query;
+  HOVER* hover = (HOVER*) data;
+  const gchar* name = hover->data + 5;
+  HTTP_REQUEST* req = NULL;
   char* url;
-  char* purl;
-  char* nonce;
-  char auth[21];
   gpointer result_str = NULL;
-  MEMFILE* mf;
-  char* body;
-
-  url = g_strdup_printf(SERVICE_USER_SHOW_URL, (gchar*) data);
+  char* body = NULL;
+  JSON_Value* root_value = NULL;
+  USER_INFO* user;
+
+  /* prefetched by the page the user appears on */
+  user = user_store_find(name, PROFILE_CACHE_TTL);
+  if (user) {
+    result_str = get_profile_text_alloc(user);
+    user_info_free(user);
+    return result_str;
+  }
+  if (!rate_budget_allows(SERVICE_USER_SHOW_URL, TRUE)) return NULL;
 
-  nonce = get_nonce_alloc();
-  query = g_strdup_printf(
-          "oauth_consumer_key=%s"
-          "&oauth_nonce=%s"
-          "&oauth_request_method=GET"
-          "&oauth_signature_method=HMAC-SHA1"
-          "&oauth_timestamp=%d"
-          "&oauth_token=%s"
-          "&oauth_version=1.0",
-          application_info.consumer_key,
-          nonce,
-          (int) time(0),
-          application_info.access_token);
-  free(nonce);
+  url = get_api_url_alloc(SERVICE_USER_SHOW_URL, name);
 
-  purl = urlencode_alloc(url);
-  ptr = urlencode_alloc(query);
-  tmp = g_strdup_printf("GET&%s&%s", purl, ptr);
-  free(purl);
-  free(ptr);
-  key = g_strdup_printf(
-          "%s&%s",
-          application_info.consumer_secret,
-          application_info.access_token_secret);
-  hmac((unsigned char*) key, strlen(key),
-          (unsigned char*) tmp, strlen(tmp), (unsigned char*) auth);
-  g_free(key);
-  g_free(tmp);
-  tmp = base64encode_alloc(auth, 20);
-  ptr = urlencode_alloc(tmp);
-  tmp = g_strdup_printf("%s&oauth_signature=%s", query, ptr);
-  free(ptr);
-  g_free(query);
-  query = tmp;
-  purl = g_strdup_printf("%s?%s", url, query);
-  g_free(url);
-  url = purl;
-
-  mf = memfopen();
-  curl = curl_easy_init();
-  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-  curl_easy_setopt(curl, CURLOPT_URL, url);
-  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, mf);
-  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-  curl_easy_perform(curl);
-  curl_easy_cleanup(curl);
+  req = oauth_request_new(SERVICE_USER_SHOW_URL, "GET", url, NULL, 0);
+  if (req) {
+    req->priority = HTTP_PRIORITY_BACKGROUND;
+    http_request_set_conditional(req, FALSE);
+  }
+  if (req && hover_set_request(hover, req) &&
+          http_request_perform(req) == CURLE_OK)
+    body = memfdetach(req->body);
+  hover_set_request(hover, NULL);
+  http_request_free(req);
 
-  g_free(query);
   g_free(url);
-  body = memfstrdup(mf);
-  memfclose(mf);
-
-  JSON_Value *root_value = json_parse_string(body);
-  JSON_Object *user = json_value_get_object(root_value);
 
-  result_str = g_strdup("");
-
-  tmp = (char*) json_object_get_string(user, "name");
-  tmp = g_strconcat(result_str, "user name:", tmp, "\n", NULL);
-  g_free(result_str);
-  result_str = tmp;
-
-  tmp = (char*) json_object_get_string(user, "screen_name");
-  tmp = g_strconcat(result_str, "screen name:", tmp, "\n", NULL);
-  g_free(result_str);
-  result_str = tmp;
-
-  tmp = (char*) json_object_get_string(user, "description");
-  tmp = g_strconcat(result_str, "description:", tmp, "\n", NULL);
-  g_free(result_str);
-  result_str = tmp;
-
-  tmp = (char*) json_object_get_string(user, "location");
-  tmp = g_strconcat(result_str, "location:", tmp, "\n", NULL);
-  g_free(result_str);
-  result_str = tmp;
-
-  tmp = (char*) json_object_get_string(user, "url");
-  tmp = g_strconcat(result_str, "url:", tmp, "\n", NULL);
-  g_free(result_str);
-  result_str = tmp;
+  root_value = json_parse_string(body);
+  user_store_add(json_value_get_object(root_value));
+  user = user_info_from_json(json_value_get_object(root_value));
+  if (user) {
+    result_str = get_profile_text_alloc(user);
+    user_info_free(user);
+  }
 
   if (root_value) json_value_free(root_value);
   if (body) free(body);
   return result_str;
 }
 
-static void
-user_profile(GtkWidget* widget, gchar* url) {
-  gpointer result;
-  GtkWidget* window = (GtkWidget*) gtk_widget_get_toplevel(widget);
-  GtkWidget* textview = (GtkWidget*) g_object_get_data(G_OBJECT(window), "textview");
-  GtkWidget* toolbox = (GtkWidget*) g_object_get_data(G_OBJECT(window), "toolbox");
-  GtkTooltips* tooltips = (GtkTooltips*) g_object_get_data(G_OBJECT(window), "tooltips");
-
-  is_processing = TRUE;
-
-  /* disable toolbox */
-  gtk_widget_set_sensitive(toolbox, FALSE);
-  /* set watch cursor at textview */
-  gdk_window_set_cursor(
-          gtk_text_view_get_window(
-              GTK_TEXT_VIEW(textview),
-              GTK_TEXT_WINDOW_TEXT),
-          watch_cursor);
-  result = process_func(user_profile_thread, url, window, _("getting profile..."));
-  if (result) {
-    gtk_tooltips_set_tip(
-            GTK_TOOLTIPS(tooltips),
-            textview,
-            result, url);
-    g_free(result);
-  }
-  /* enable toolbox */
-  gtk_widget_set_sensitive(toolbox, TRUE);
-  /* set regular cursor at textview */
-  gdk_window_set_cursor(
-          gtk_text_view_get_window(
-              GTK_TEXT_VIEW(textview),
-              GTK_TEXT_WINDOW_TEXT),
-          regular_cursor);
-
-  is_processing = FALSE;
-}
-
 /**
  * expand short url
  */
 static gpointer
 expand_short_url_thread(gpointer data) {
-  CURL* curl = NULL;
-  gpointer result_str = NULL;
-  MEMFILE* mf;
-  char* head;
-
-  mf = memfopen();
-  curl = curl_easy_init();
-  curl_easy_setopt(curl, CURLOPT_VERBOSE, 0);
-  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-  curl_easy_setopt(curl, CURLOPT_URL, (gchar*) data);
-  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_HEADERDATA, mf);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, NULL);
-  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 0);
-  curl_easy_perform(curl);
-  curl_easy_cleanup(curl);
-
-  head = memfstrdup(mf);
-  memfclose(mf);
-  result_str = get_http_header_alloc(head, "Location");
-  free(head);
+  HOVER* hover = (HOVER*) data;
+  const gchar* url = hover->data + 4;
+  HTTP_REQUEST* req = NULL;
+  gchar* result;
+
+  result = short_url_lookup_alloc(url);
+  if (result) return result;
+
+  req = short_url_request_new(url, FALSE);
+  if (req && hover_set_request(hover, req)) {
+    http_request_perform(req);
+    hover_set_request(hover, NULL);
+    result = short_url_result_alloc(req);
+    if (!result && short_url_refused(req)) {
+      http_request_free(req);
+      req = short_url_request_new(url, TRUE);
+      if (req && hover_set_request(hover, req)) {
+        http_request_perform(req);
+        hover_set_request(hover, NULL);
+        result = short_url_result_alloc(req);
+      }
+    }
+  }
+  http_request_free(req);
 
-  return result_str;
+  if (result) short_url_store(url, result);
+  return result;
 }
 
-static void
-expand_short_url(GtkWidget* widget, gchar* url) {
-  gpointer result;
-  GtkWidget* window = (GtkWidget*) gtk_widget_get_toplevel(widget);
-  GtkWidget* textview = (GtkWidget*) g_object_get_data(G_OBJECT(window), "textview");
-  GtkWidget* toolbox = (GtkWidget*) g_object_get_data(G_OBJECT(window), "toolbox");
-  GtkTooltips* tooltips = (GtkTooltips*) g_object_get_data(G_OBJECT(window), "tooltips");
-
-  is_processing = TRUE;
+static gboolean
+hover_done(gpointer data) {
+  HOVER* hover = (HOVER*) data;
+  GtkWidget* window = hover->window;
 
-  /* disable toolbox */
-  gtk_widget_set_sensitive(toolbox, FALSE);
-  /* set watch cursor at textview */
-  gdk_window_set_cursor(
-          gtk_text_view_get_window(
-              GTK_TEXT_VIEW(textview),
-              GTK_TEXT_WINDOW_TEXT),
-          watch_cursor);
-  result = process_func(expand_short_url_thread, url, window, _("expanding URL..."));
-  if (result) {
-    gtk_tooltips_set_tip(
-            GTK_TOOLTIPS(tooltips),
-            textview,
-            result, url);
-    g_free(result);
+  gdk_threads_enter();
+  if (g_object_get_data(G_OBJECT(window), "hover") == hover) {
+    GtkWidget* textview = (GtkWidget*) g_object_get_data(G_OBJECT(window), "textview");
+    GtkTooltips* tooltips = (GtkTooltips*) g_object_get_data(G_OBJECT(window), "tooltips");
+    if (hover->result)
+      gtk_tooltips_set_tip(
+              GTK_TOOLTIPS(tooltips),
+              textview,
+              hover->result, strchr(hover->data, ':') + 1);
+    g_object_set_data(G_OBJECT(window), "hover", NULL);
   }
-  /* enable toolbox */
-  gtk_widget_set_sensitive(toolbox, TRUE);
-  /* set regular cursor at textview */
-  gdk_window_set_cursor(
-          gtk_text_view_get_window(
-              GTK_TEXT_VIEW(textview),
-              GTK_TEXT_WINDOW_TEXT),
-          regular_cursor);
+  gdk_threads_leave();
 
-  is_processing = FALSE;
+  g_free(hover->data);
+  g_free(hover->result);
+  g_free(hover);
+  return FALSE;
+}
+
+static gpointer
+hover_thread(gpointer data) {
+  HOVER* hover = (HOVER*) data;
+
+  if (!strncmp(hover->data, "url:", 4))
+    hover->result = expand_short_url_thread(hover);
+  else if (!strncmp(hover->data, "user:", 5))
+    hover->result = user_profile_thread(hover);
+  g_idle_add(hover_done, hover);
+  return NULL;
+}
+
+/* looks up tooltip_data for window, replacing the hover being looked up */
+static void
+hover_start(GtkWidget* window, const gchar* tooltip_data) {
+  HOVER* hover;
+
+  hover_stop(window);
+  hover = (HOVER*) g_malloc0(sizeof(HOVER));
+  hover->window = window;
+  hover->data = g_strdup(tooltip_data);
+  g_object_set_data(G_OBJECT(window), "hover", hover);
+  if (!g_thread_create(hover_thread, hover, FALSE, NULL)) {
+    g_object_set_data(G_OBJECT(window), "hover", NULL);
+    g_free(hover->data);
+    g_free(hover);
+  }
 }
 
 /**
@@ -2652,23 +4455,15 @@ expand_short_url(GtkWidget* widget, gchar* url) {
 static gpointer
 favorite_status_thread(gpointer data) {
   GtkWidget* window = (GtkWidget*) data;
-  CURL* curl = NULL;
+  HTTP_REQUEST* req = NULL;
   CURLcode res = CURLE_OK;
   long http_status = 0;
 
-  char* ptr = NULL;
-  char* tmp;
   char* status_id = NULL;
-  char* key;
-  char* query;
-  char* nonce;
   char* url;
-  char* purl;
-  char auth[21];
-  char error[CURL_ERROR_SIZE];
+  const char* endpoint;
   gpointer result_str = NULL;
-  MEMFILE* mbody;
-  char* body;
+  char* body = NULL;
 
   gdk_threads_enter();
   status_id = g_object_get_data(G_OBJECT(window), "favorite");
@@ -2676,66 +4471,21 @@ favorite_status_thread(gpointer data) {
 
   if (!status_id || strlen(status_id) == 0) return NULL;
   if (*status_id == '-') {
-    url = g_strdup_printf(SERVICE_UNFAVORITE_URL, status_id+1);
+    endpoint = SERVICE_UNFAVORITE_URL;
+    url = get_api_url_alloc(endpoint, status_id+1);
   } else {
-    url = g_strdup_printf(SERVICE_FAVORITE_URL, status_id);
+    endpoint = SERVICE_FAVORITE_URL;
+    url = get_api_url_alloc(endpoint, status_id);
   }
 
-  nonce = get_nonce_alloc();
-  query = g_strdup_printf(
-          "oauth_consumer_key=%s"
-          "&oauth_nonce=%s"
-          "&oauth_request_method=POST"
-          "&oauth_signature_method=HMAC-SHA1"
-          "&oauth_timestamp=%d"
-          "&oauth_token=%s"
-          "&oauth_version=1.0",
-          application_info.consumer_key,
-          nonce,
-          (int) time(0),
-          application_info.access_token);
-  free(nonce);
-
-  purl = urlencode_alloc(url);
-  ptr = urlencode_alloc(query);
-  tmp = g_strdup_printf("POST&%s&%s", purl, ptr);
-  free(purl);
-  free(ptr);
-  key = g_strdup_printf(
-          "%s&%s",
-          application_info.consumer_secret,
-          application_info.access_token_secret);
-  hmac((unsigned char*) key, strlen(key),
-          (unsigned char*) tmp, strlen(tmp), (unsigned char*) auth);
-  g_free(key);
-  g_free(tmp);
-  tmp = base64encode_alloc(auth, 20);
-  ptr = urlencode_alloc(tmp);
-  free(tmp);
-  tmp = g_strdup_printf("%s&oauth_signature=%s", query, ptr);
-  free(ptr);
-  g_free(query);
-  query = tmp;
-
-  mbody = memfopen();
-  curl = curl_easy_init();
-  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error);
-  curl_easy_setopt(curl, CURLOPT_URL, url);
-  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_POST, 1);
-  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, query);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, mbody);
-  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-  res = curl_easy_perform(curl);
+  req = oauth_request_new(endpoint, "POST", url, NULL, 0);
+  res = http_request_perform(req);
   if (res == CURLE_OK)
-    curl_easy_getinfo(curl, CURLINFO_HTTP_CODE, &http_status);
-  curl_easy_cleanup(curl);
+    http_status = req->http_status;
 
-  g_free(query);
-  body = memfstrdup(mbody);
+  g_free(url);
+  if (req) body = memfdetach(req->body);
+  http_request_free(req);
 
   if (http_status != 200) {
     if (body) {
@@ -2784,8 +4534,6 @@ favorite_status(GtkWidget* widget, GtkTextTag* tag) {
     else
       g_object_set_data(G_OBJECT(tag), "favorite", g_strdup(status_id+1));
     g_free(status_id);
-
-    clean_condition();
   }
   if (result) {
     /* show error message */
@@ -2811,23 +4559,16 @@ static gpointer
 post_status_thread(gpointer data) {
   GtkWidget* window = (GtkWidget*) data;
   GtkWidget* entry = NULL;
-  CURL* curl = NULL;
+  HTTP_REQUEST* req = NULL;
   CURLcode res = CURLE_OK;
   long http_status = 0;
 
   gchar* in_reply_to_status_id = NULL;
   char* ptr = NULL;
-  char* tmp;
   char* status = NULL;
-  char* status_encoded;
-  char* key;
-  char* query;
-  char* nonce;
-  char* purl;
-  char auth[21];
-  char error[CURL_ERROR_SIZE];
+  char* url;
+  OAUTH_PARAM params[2];
   gpointer result_str = NULL;
-  MEMFILE* mbody;
   char* body = NULL;
 
   gdk_threads_enter();
@@ -2839,88 +4580,28 @@ post_status_thread(gpointer data) {
 
   ptr = get_short_status_alloc(status);
   if (!ptr) ptr = strdup(status);
-  status_encoded = urlencode_alloc(ptr);
-  free(ptr);
-
-  nonce = get_nonce_alloc();
-  query = g_strdup_printf(
-          "oauth_consumer_key=%s"
-          "&oauth_nonce=%s"
-          "&oauth_request_method=POST"
-          "&oauth_signature_method=HMAC-SHA1"
-          "&oauth_timestamp=%d"
-          "&oauth_token=%s"
-          "&oauth_version=1.0"
-          "&status=%s",
-          application_info.consumer_key,
-          nonce,
-          (int) time(0),
-          application_info.access_token,
-          status_encoded);
-  free(nonce);
-  free(status_encoded);
 
+  gdk_threads_enter();
   in_reply_to_status_id = g_object_get_data(G_OBJECT(window), "in_reply_to_status_id");
-  if (in_reply_to_status_id) {
-    tmp = g_strdup_printf("in_reply_to_status_id=%s&%s", in_reply_to_status_id, query);
-    g_free(query);
-    query = tmp;
-  }
+  gdk_threads_leave();
 
-  purl = urlencode_alloc(SERVICE_UPDATE_URL);
-  ptr = urlencode_alloc(query);
-  tmp = g_strdup_printf("POST&%s&%s", purl, ptr);
-  free(purl);
-  free(ptr);
-  key = g_strdup_printf(
-          "%s&%s",
-          application_info.consumer_secret,
-          application_info.access_token_secret);
-  hmac((unsigned char*) key, strlen(key),
-          (unsigned char*) tmp, strlen(tmp), (unsigned char*) auth);
-  g_free(key);
-  g_free(tmp);
-  tmp = base64encode_alloc(auth, 20);
-  ptr = urlencode_alloc(tmp);
-  free(tmp);
-  tmp = g_strdup_printf("%s&oauth_signature=%s", query, ptr);
+  url = get_api_url_alloc(SERVICE_UPDATE_URL);
+  params[0].name = "in_reply_to_status_id"; params[0].value = in_reply_to_status_id;
+  params[1].name = "status";                params[1].value = ptr;
+  req = oauth_request_new(SERVICE_UPDATE_URL, "POST", url, params, 2);
   free(ptr);
-  g_free(query);
-  query = tmp;
-
-  mbody = memfopen();
-  curl = curl_easy_init();
-  curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error);
-  curl_easy_setopt(curl, CURLOPT_URL, SERVICE_UPDATE_URL);
-  curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
-  curl_easy_setopt(curl, CURLOPT_POST, 1);
-  curl_easy_setopt(curl, CURLOPT_POSTFIELDS, query);
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, memfwrite);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, mbody);
-  curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-  res = curl_easy_perform(curl);
+  g_free(url);
+  res = http_request_perform(req);
   if (res == CURLE_OK)
-    curl_easy_getinfo(curl, CURLINFO_HTTP_CODE, &http_status);
-  if (http_status == 417) {
-    struct curl_slist* headers = NULL;
-    headers = curl_slist_append(headers, "Expect: ");
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    res = curl_easy_perform(curl);
-    curl_slist_free_all(headers);
-    if (res == CURLE_OK)
-      curl_easy_getinfo(curl, CURLINFO_HTTP_CODE, &http_status);
-  }
-  curl_easy_cleanup(curl);
+    http_status = req->http_status;
 
-  g_free(query);
-  body = memfstrdup(mbody);
-  memfclose(mbody);
+  if (req) body = memfdetach(req->body);
   if (res != CURLE_OK) {
-    result_str = g_strdup(error);
+    result_str = g_strdup(req ? req->error : curl_easy_strerror(res));
+    http_request_free(req);
     goto leave;
   }
+  http_request_free(req);
   if (http_status != 200) {
     if (body) {
       result_str = g_strdup(body);
@@ -2946,11 +4627,15 @@ post_status(GtkWidget* widget, gpointer user_data) {
   GtkWidget* window = (GtkWidget*) user_data;
   GtkWidget* textview = (GtkWidget*) g_object_get_data(G_OBJECT(window), "textview");
   GtkWidget* toolbox = (GtkWidget*) g_object_get_data(G_OBJECT(window), "toolbox");
+  /* post may be made while a refresh is running */
+  int refreshing = is_processing;
 
+  if (is_posting) return;
   if (!application_info.access_token_secret) {
     if (!setup_dialog(window)) return;
   }
 
+  is_posting = TRUE;
   is_processing = TRUE;
 
   /* disable toolbox */
@@ -2962,8 +4647,7 @@ post_status(GtkWidget* widget, gpointer user_data) {
               GTK_TEXT_WINDOW_TEXT),
           watch_cursor);
   result = process_func(post_status_thread, window, window, _("posting status..."));
-  if (!result) {
-    clean_condition();
+  if (!result && !refreshing) {
     clean_context(window);
     result = process_func(update_timeline_thread, window, window, _("updating statuses..."));
   }
@@ -2975,13 +4659,15 @@ post_status(GtkWidget* widget, gpointer user_data) {
   /* enable toolbox */
   gtk_widget_set_sensitive(toolbox, TRUE);
   /* set regular cursor at textview */
-  gdk_window_set_cursor(
-          gtk_text_view_get_window(
-              GTK_TEXT_VIEW(textview),
-              GTK_TEXT_WINDOW_TEXT),
-          regular_cursor);
+  if (!refreshing)
+    gdk_window_set_cursor(
+            gtk_text_view_get_window(
+                GTK_TEXT_VIEW(textview),
+                GTK_TEXT_WINDOW_TEXT),
+            regular_cursor);
 
-  is_processing = FALSE;
+  is_processing = refreshing;
+  is_posting = FALSE;
 }
 
 /**
@@ -2991,7 +4677,6 @@ static void
 on_reload_clicked(GtkWidget* widget, gpointer user_data) {
   GtkWidget* window = gtk_widget_get_toplevel(widget);
   gchar* mode = g_object_get_data(G_OBJECT(window), "mode");
-  clean_condition();
   if (mode && !strcmp(mode, "search")) {
     search_timeline(window, NULL);
   } else {
@@ -3007,7 +4692,7 @@ on_entry_activate(GtkWidget* widget, gpointer user_data) {
   GtkWidget* window = gtk_widget_get_toplevel(widget);
   char* message = (char*) gtk_entry_get_text(GTK_ENTRY(widget));
 
-  if (is_processing) return FALSE;
+  if (is_posting) return FALSE;
   if (!message || strlen(message) == 0) return FALSE;
   stop_reload_timer(window);
   post_status(widget, user_data);
@@ -3067,7 +4752,6 @@ search_dialog(GtkWidget* widget, gpointer user_data) {
   gtk_widget_destroy(dialog);
 
   if (ret == GTK_RESPONSE_OK) {
-    clean_condition();
     clean_context(window);
     g_object_set_data(G_OBJECT(window), "mode", g_strdup("search"));
     g_object_set_data(G_OBJECT(window), "search", g_strdup(word));
@@ -3220,16 +4904,12 @@ tooltip_timer_func(gpointer data) {
   GtkWidget* window = (GtkWidget*) data;
   gchar* tooltip_data;
 
+  tooltip_timer = 0;
   tooltip_data = g_object_get_data(G_OBJECT(window), "tooltip_data");
   if (!tooltip_data) return 0;
 
   gdk_threads_enter();
-  if (!strncmp(tooltip_data, "url:", 4)) {
-    expand_short_url(window, tooltip_data+4);
-  }
-  if (!strncmp(tooltip_data, "user:", 5)) {
-    user_profile(window, tooltip_data+5);
-  }
+  hover_start(window, tooltip_data);
   gdk_threads_leave();
   return 0;
 }
@@ -3246,10 +4926,6 @@ textview_change_cursor(GtkWidget* textview, gint x, gint y) {
   gchar* short_url = NULL;
   int len, n;
 
-  if (is_processing) {
-    return;
-  }
-
   gtk_text_view_get_iter_at_location(GTK_TEXT_VIEW(textview), &iter, x, y);
   tooltips = (GtkTooltips*) g_object_get_data(G_OBJECT(window), "tooltips");
 
@@ -3262,13 +4938,13 @@ textview_change_cursor(GtkWidget* textview, gint x, gint y) {
         if (g_object_get_data(G_OBJECT(tag), "url")) {
           hovering = TRUE;
           short_url = g_object_get_data(G_OBJECT(tag), "url");
-          g_object_set_data(G_OBJECT(window), "tooltip_data", g_strdup_printf("url:%s", short_url));
+          g_object_set_data_full(G_OBJECT(window), "tooltip_data", g_strdup_printf("url:%s", short_url), g_free);
           break;
         }
         if (g_object_get_data(G_OBJECT(tag), "user_id")) {
           hovering = TRUE;
           user_id = g_object_get_data(G_OBJECT(tag), "user_id");
-          g_object_set_data(G_OBJECT(window), "tooltip_data", g_strdup_printf("user:%s", user_id));
+          g_object_set_data_full(G_OBJECT(window), "tooltip_data", g_strdup_printf("user:%s", user_id), g_free);
           break;
         }
         if (   g_object_get_data(G_OBJECT(tag), "status_url")
@@ -3285,11 +4961,13 @@ textview_change_cursor(GtkWidget* textview, gint x, gint y) {
   }
   if (hovering != hovering_over_link) {
     hovering_over_link = hovering;
-    gdk_window_set_cursor(
-            gtk_text_view_get_window(
-                GTK_TEXT_VIEW(textview),
-                GTK_TEXT_WINDOW_TEXT),
-            hovering_over_link ? hand_cursor : regular_cursor);
+    /* watch cursor stays while processing, hover cards don't wait for it */
+    if (!is_processing)
+      gdk_window_set_cursor(
+              gtk_text_view_get_window(
+                  GTK_TEXT_VIEW(textview),
+                  GTK_TEXT_WINDOW_TEXT),
+              hovering_over_link ? hand_cursor : regular_cursor);
 
     if (hovering_over_link) {
       tooltip_timer = g_timeout_add_full(
@@ -3299,11 +4977,10 @@ textview_change_cursor(GtkWidget* textview, gint x, gint y) {
               window,
               NULL);
     } else {
-      gchar* old_data = g_object_get_data(G_OBJECT(window), "tooltip_data");
-      if (old_data) g_free(old_data);
       g_object_set_data(G_OBJECT(window), "tooltip_data", NULL);
-      g_source_remove(tooltip_timer);
+      if (tooltip_timer) g_source_remove(tooltip_timer);
       tooltip_timer = 0;
+      hover_stop(window);
       gtk_tooltips_set_tip(
               GTK_TOOLTIPS(tooltips),
               textview,
@@ -3408,7 +5085,6 @@ textview_event_after(GtkWidget* textview, GdkEvent* ev) {
         tag_data = g_object_get_data(G_OBJECT(tag), "tag_name");
         if (tag_data) {
           gchar* word = g_strdup(tag_data);
-          clean_condition();
           clean_context(window);
           g_object_set_data(G_OBJECT(window), "mode", g_strdup("search"));
           g_object_set_data(G_OBJECT(window), "search", word);
@@ -3492,15 +5168,8 @@ swin_vadjust_value_changed(GtkAdjustment* vadjust, gpointer user_data) {
   if (!is_processing && gtk_adjustment_get_upper(vadjust) ==
           gtk_adjustment_get_value(vadjust)
           + gtk_adjustment_get_page_size(vadjust)) {
-
     gchar* mode = g_object_get_data(G_OBJECT(window), "mode");
-    if (mode && (!strcmp(mode, "replies") || !strcmp(mode, "search"))) {
-      gchar* page = g_object_get_data(G_OBJECT(window), "page");
-      int page_no = atoi(page ? page : "1");
-      if (page) g_free(page);
-      g_object_set_data(G_OBJECT(window), "page", g_strdup_printf("%d", page_no+1));
-    }
-    clean_condition();
+    /* last_status_id is the cursor of the next page */
     if (mode && !strcmp(mode, "search")) {
       search_timeline(window, NULL);
     } else {
@@ -3541,6 +5210,24 @@ load_config() {
       application_info.access_token_secret = strdup(line+20);
     if (!strncmp(line, "font=", 5))
       application_info.font = strdup(line+5);
+    if (!strncmp(line, "idle_time=", 10))
+      application_info.idle_time = atoi(line+10);
+    if (!strncmp(line, "log_file=", 9))
+      application_info.log_file = strdup(line+9);
+    if (!strncmp(line, "api_url=", 8))
+      application_info.api_url = strdup(line+8);
+    if (!strncmp(line, "record_dir=", 11))
+      application_info.record_dir = strdup(line+11);
+    if (!strncmp(line, "replay_dir=", 11))
+      application_info.replay_dir = strdup(line+11);
+    if (!strncmp(line, "replay_latency=", 15))
+      application_info.replay_latency = atoi(line+15);
+    if (!strncmp(line, "replay_bandwidth=", 17))
+      application_info.replay_bandwidth = atoi(line+17);
+    if (!strncmp(line, "streaming=", 10))
+      application_info.streaming = atoi(line+10);
+    if (!strncmp(line, "stream_url=", 11))
+      application_info.stream_url = strdup(line+11);
   }
   fclose(fp);
   return 0;
@@ -3564,6 +5251,24 @@ save_config() {
   fprintf(fp, "access_token=%s\n", SAFE_STRING(application_info.access_token));
   fprintf(fp, "access_token_secret=%s\n", SAFE_STRING(application_info.access_token_secret));
   fprintf(fp, "font=%s\n", SAFE_STRING(application_info.font));
+  if (application_info.idle_time > 0)
+    fprintf(fp, "idle_time=%d\n", application_info.idle_time);
+  if (application_info.log_file)
+    fprintf(fp, "log_file=%s\n", application_info.log_file);
+  if (application_info.api_url)
+    fprintf(fp, "api_url=%s\n", application_info.api_url);
+  if (application_info.record_dir)
+    fprintf(fp, "record_dir=%s\n", application_info.record_dir);
+  if (application_info.replay_dir)
+    fprintf(fp, "replay_dir=%s\n", application_info.replay_dir);
+  if (application_info.replay_latency > 0)
+    fprintf(fp, "replay_latency=%d\n", application_info.replay_latency);
+  if (application_info.replay_bandwidth > 0)
+    fprintf(fp, "replay_bandwidth=%d\n", application_info.replay_bandwidth);
+  if (application_info.streaming)
+    fprintf(fp, "streaming=%d\n", application_info.streaming);
+  if (application_info.stream_url)
+    fprintf(fp, "stream_url=%s\n", application_info.stream_url);
 #undef SAFE_STRING
   fclose(fp);
   return 0;
@@ -3595,6 +5300,7 @@ main(int argc, char* argv[]) {
   guint context_id;
 
   srandom(time(0));
+  curl_global_init(CURL_GLOBAL_ALL);
 
 #ifdef _LIBINTL_H
   setlocale(LC_CTYPE, "");
@@ -3620,6 +5326,9 @@ main(int argc, char* argv[]) {
   gdk_threads_enter();
 
   gtk_init(&argc, &argv);
+  curl_handle_init();
+  http_engine_init();
+  short_url_load();
 
   /*------------------*/
   /* building window. */
@@ -3689,6 +5398,7 @@ main(int argc, char* argv[]) {
   /* horizontal container box for buttons */
   hbox = gtk_hbox_new(FALSE, 6);
   gtk_box_pack_start(GTK_BOX(toolbox), hbox, FALSE, TRUE, 0);
+  g_object_set_data(G_OBJECT(window), "buttonbox", hbox);
 
   /* home button */
   button = gtk_button_new();
@@ -3826,14 +5536,19 @@ main(int argc, char* argv[]) {
     pango_font_description_free(pangoFont);
   }
 
-  check_ratelimit(window, statusbar);
-
   update_timeline(window, NULL);
+  if (application_info.streaming) timeline_stream_start(window);
 
   gtk_main();
+  timeline_stream_stop();
 
   gdk_threads_leave();
 
+  http_engine_cleanup();
+  short_url_save();
+  curl_handle_cleanup();
+  curl_global_cleanup();
+
   return 0;
 }
 
@@ -0,0 +1,291 @@
+/* Copyright 2010 by Yasuhiro Matsumoto
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * micro-benchmarks
+ *
+ * times the primitives every signed request goes through, on inputs of
+ * the sizes they see: a short parameter, a full 280 letter status and a
+ * 4 KB signature base string. ns/op is the best of BENCH_REPEAT runs,
+ * allocations are counted by wrapping malloc where glibc allows it.
+ * with -j the results are written as JSON as well, to compare versions:
+ *
+ *   microbench [-t seconds per case] [-j bench.json]
+ *
+ * "make bench" builds and runs it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "sha1.h"
+#include "codec.h"
+
+#define BENCH_TIME   (0.2)
+#define BENCH_REPEAT (5)
+#define BENCH_COUNT  (100)
+
+#define BENCH_PARAM  (42)
+#define BENCH_STATUS (280)
+#define BENCH_BASE   (4096)
+
+#define BENCH_KEY "kAcSOqF21Fu85e7zjz7ZN2U4ZRhfV3WpwPAoE3Z7kBw&LswwdoUaIvS8ltyTt5jkRh4J50vUPVVHtR2YPi5kE"
+
+#ifdef __GLIBC__
+# define BENCH_ALLOCS
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static unsigned long bench_allocs = 0;
+
+void*
+malloc(size_t size) {
+  bench_allocs++;
+  return __libc_malloc(size);
+}
+
+void*
+calloc(size_t count, size_t size) {
+  bench_allocs++;
+  return __libc_calloc(count, size);
+}
+
+void*
+realloc(void* ptr, size_t size) {
+  bench_allocs++;
+  return __libc_realloc(ptr, size);
+}
+
+void
+free(void* ptr) {
+  __libc_free(ptr);
+}
+#endif
+
+typedef void (*bench_func)(const char* input, size_t size);
+
+typedef struct _BENCH_CASE {
+  const char* name;
+  bench_func func;
+  int sized;          /* 0 when the input doesn't matter */
+} BENCH_CASE;
+
+typedef struct _BENCH_INPUT {
+  const char* name;
+  char* data;         /* NUL terminated */
+  size_t size;
+} BENCH_INPUT;
+
+static hmac_key bench_key;
+static unsigned char bench_digest[20];
+
+static double
+now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+run_sha1(const char* input, size_t size) {
+  sha1((const unsigned char*) input, size, bench_digest);
+}
+
+static void
+run_hmac(const char* input, size_t size) {
+  hmac((const unsigned char*) BENCH_KEY, sizeof(BENCH_KEY) - 1,
+          (const unsigned char*) input, size, bench_digest);
+}
+
+/* with the key state the signer keeps for the last credentials */
+static void
+run_hmac_key_sign(const char* input, size_t size) {
+  hmac_key_sign(&bench_key, (const unsigned char*) input, size, bench_digest);
+}
+
+static void
+run_get_nonce_alloc(const char* input, size_t size) {
+  (void) input;
+  (void) size;
+  free(get_nonce_alloc());
+}
+
+static void
+run_base64encode_alloc(const char* input, size_t size) {
+  free(base64encode_alloc((const unsigned char*) input, size));
+}
+
+static void
+run_urlencode_alloc(const char* input, size_t size) {
+  (void) size;
+  free(urlencode_alloc(input));
+}
+
+static void
+run_to_hex_alloc(const char* input, size_t size) {
+  free(to_hex_alloc((const unsigned char*) input, size));
+}
+
+static const BENCH_CASE bench_cases[] = {
+  { "sha1",               run_sha1,               1 },
+  { "hmac",               run_hmac,               1 },
+  { "hmac_key_sign",      run_hmac_key_sign,      1 },
+  { "get_nonce_alloc",    run_get_nonce_alloc,    0 },
+  { "base64encode_alloc", run_base64encode_alloc, 1 },
+  { "urlencode_alloc",    run_urlencode_alloc,    1 },
+  { "to_hex_alloc",       run_to_hex_alloc,       1 },
+};
+#define BENCH_CASES ((int) (sizeof(bench_cases) / sizeof(bench_cases[0])))
+
+/* repeats text up to size letters */
+static char*
+bench_input_alloc(const char* text, size_t size) {
+  size_t len = strlen(text), n;
+  char* data = (char*) malloc(size + 1);
+  if (!data) return NULL;
+  for (n = 0; n < size; n++) data[n] = text[n % len];
+  data[size] = 0;
+  return data;
+}
+
+/* nanoseconds per call, best of BENCH_REPEAT runs of span seconds */
+static double
+bench_time(bench_func func, const BENCH_INPUT* input, double span) {
+  double best = 0;
+  int repeat;
+
+  for (repeat = 0; repeat < BENCH_REPEAT; repeat++) {
+    double start = now(), elapsed;
+    long ops = 0, n, round = 16;
+    do {
+      for (n = 0; n < round; n++)
+        func(input->data, input->size);
+      ops += round;
+      round *= 2;
+      elapsed = now() - start;
+    } while (elapsed < span / BENCH_REPEAT);
+    if (!repeat || elapsed * 1e9 / ops < best) best = elapsed * 1e9 / ops;
+  }
+  return best;
+}
+
+/* allocations per call, -1 when they can't be counted */
+static double
+bench_allocs_per_op(bench_func func, const BENCH_INPUT* input) {
+#ifdef BENCH_ALLOCS
+  unsigned long before = bench_allocs;
+  int n;
+  for (n = 0; n < BENCH_COUNT; n++)
+    func(input->data, input->size);
+  return (double) (bench_allocs - before) / BENCH_COUNT;
+#else
+  (void) func;
+  (void) input;
+  return -1;
+#endif
+}
+
+int
+main(int argc, char* argv[]) {
+  BENCH_INPUT inputs[3];
+  const char* json_path = NULL;
+  double span = BENCH_TIME;
+  FILE* json = NULL;
+  int first = 1;
+  int c, i, s;
+
+  while ((c = getopt(argc, argv, "t:j:")) != -1) {
+    switch (c) {
+    case 't': span = atof(optarg); break;
+    case 'j': json_path = optarg; break;
+    default:
+      fprintf(stderr, "usage: %s [-t seconds] [-j file.json]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  /* a parameter, a status and a base string with everything encoded */
+  inputs[0].name = "param";
+  inputs[0].data = bench_input_alloc("oauth_consumer_key=xvz1evFS4wEEPTGEFPHBog", BENCH_PARAM);
+  inputs[1].name = "status";
+  inputs[1].data = bench_input_alloc("Hello Ladies + Gentlemen, a signed OAuth request! ", BENCH_STATUS);
+  inputs[2].name = "base";
+  inputs[2].data = bench_input_alloc("POST&https%3A%2F%2Fapi.twitter.com%2F1.1%2Fstatuses%2Fupdate.json&"
+          "include_entities%3Dtrue%26oauth_consumer_key%3Dxvz1evFS4wEEPTGEFPHBog%26", BENCH_BASE);
+  for (s = 0; s < 3; s++) {
+    if (!inputs[s].data) return 1;
+    inputs[s].size = strlen(inputs[s].data);
+  }
+  hmac_key_init(&bench_key, (const unsigned char*) BENCH_KEY, sizeof(BENCH_KEY) - 1);
+
+  if (json_path) {
+    json = fopen(json_path, "w");
+    if (!json) {
+      perror(json_path);
+      return 1;
+    }
+    fprintf(json, "{\n  \"sha1_impl\": \"%s\",\n  \"results\": [",
+            sha1_impl_name(sha1_get_impl()));
+  }
+
+  printf("%-20s %-7s %6s %10s %12s %10s\n",
+          "primitive", "input", "bytes", "ns/op", "MB/s", "allocs/op");
+  for (i = 0; i < BENCH_CASES; i++) {
+    const BENCH_CASE* bc = &bench_cases[i];
+    for (s = 0; s < (bc->sized ? 3 : 1); s++) {
+      const BENCH_INPUT* input = &inputs[s];
+      const char* name = bc->sized ? input->name : "-";
+      size_t bytes = bc->sized ? input->size : 0;
+      double ns = bench_time(bc->func, input, span);
+      double allocs = bench_allocs_per_op(bc->func, input);
+
+      printf("%-20s %-7s %6d %10.1f ", bc->name, name, (int) bytes, ns);
+      if (bytes) printf("%12.1f ", bytes * 1e3 / ns);
+      else printf("%12s ", "-");
+      if (allocs < 0) printf("%10s\n", "-");
+      else printf("%10.2f\n", allocs);
+      if (!json) continue;
+      fprintf(json, "%s\n    {\"name\": \"%s\", \"input\": \"%s\", \"bytes\": %d, "
+              "\"ns_per_op\": %.1f, \"bytes_per_sec\": ",
+              first ? "" : ",", bc->name, name, (int) bytes, ns);
+      if (bytes) fprintf(json, "%.0f, \"allocs_per_op\": ", bytes * 1e9 / ns);
+      else fprintf(json, "null, \"allocs_per_op\": ");
+      if (allocs < 0) fprintf(json, "null}");
+      else fprintf(json, "%.2f}", allocs);
+      first = 0;
+    }
+  }
+  printf("sha1: %s\n", sha1_impl_name(sha1_get_impl()));
+
+  if (json) {
+    fprintf(json, "\n  ]\n}\n");
+    fclose(json);
+  }
+  for (s = 0; s < 3; s++) free(inputs[s].data);
+  return 0;
+}
+
+/* vim:set et sw=4: */
@@ -71,6 +71,26 @@ struct json_array_t {
     size_t       capacity;
 };
 
+typedef enum json_stream_state {
+    StreamStart = 0, /* waiting for top level '[' */
+    StreamArray = 1, /* between elements */
+    StreamValue = 2, /* inside an element */
+    StreamDone  = 3,
+    StreamError = 4
+} JSON_Stream_State;
+
+struct json_stream_t {
+    JSON_Stream_Callback callback;
+    void                *user_data;
+    JSON_Stream_State    state;
+    char                *buffer; /* text of the current element */
+    size_t               length;
+    size_t               capacity;
+    size_t               depth;
+    int                  in_string;
+    int                  escaped;
+};
+
 /* Various */
 static int    try_realloc(void **ptr, size_t new_size);
 static char * parson_strndup(const char *string, size_t n);
@@ -109,6 +129,10 @@ static JSON_Value * parse_number_value(const char **string);
 static JSON_Value * parse_null_value(const char **string);
 static JSON_Value * parse_value(const char **string, size_t nesting);
 
+/* Stream parser */
+static int json_stream_append(JSON_Stream *stream, const char *chunk, size_t length);
+static int json_stream_emit(JSON_Stream *stream);
+
 /* Various */
 static int try_realloc(void **ptr, size_t new_size) {
     void *reallocated_ptr = parson_realloc(*ptr, new_size);
@@ -513,6 +537,134 @@ JSON_Value * json_parse_string(const char *string) {
     return parse_value((const char**)&string, 0);
 }
 
+JSON_Value * json_parse_nstring(const char *string, size_t length) {
+    char *terminated_string;
+    JSON_Value *output_value;
+    if (!string || length == 0 || (*string != '{' && *string != '[')) { return NULL; }
+    if (memchr(string, '\0', length)) { return NULL; }
+    /* the scanner relies on a terminating NUL, so copy once */
+    terminated_string = parson_strndup(string, length);
+    if (!terminated_string) { return NULL; }
+    output_value = json_parse_string(terminated_string);
+    parson_free(terminated_string);
+    return output_value;
+}
+
+/* Stream parser */
+static int json_stream_append(JSON_Stream *stream, const char *chunk, size_t length) {
+    /* keeps room for a trailing space and NUL, see json_stream_emit */
+    if (stream->length + length + 2 > stream->capacity) {
+        size_t new_capacity = MAX(stream->capacity * 2, stream->length + length + 2);
+        if (try_realloc((void**)&stream->buffer, new_capacity) == ERROR) { return ERROR; }
+        stream->capacity = new_capacity;
+    }
+    memcpy(stream->buffer + stream->length, chunk, length);
+    stream->length += length;
+    stream->buffer[stream->length] = '\0';
+    return SUCCESS;
+}
+
+static int json_stream_emit(JSON_Stream *stream) {
+    const char *string = stream->buffer;
+    JSON_Value *value;
+    /* get_processed_string needs a character after the closing quote */
+    stream->buffer[stream->length] = ' ';
+    stream->buffer[stream->length + 1] = '\0';
+    value = parse_value(&string, 1);
+    stream->length = 0;
+    stream->depth = 0;
+    if (!value) { return ERROR; }
+    while (isspace((unsigned char)*string)) { string++; }
+    if (*string != '\0') { json_value_free(value); return ERROR; }
+    stream->callback(value, stream->user_data);
+    return SUCCESS;
+}
+
+/* Stream parser API */
+JSON_Stream * json_stream_new(JSON_Stream_Callback callback, void *user_data) {
+    JSON_Stream *stream = (JSON_Stream*)parson_malloc(sizeof(JSON_Stream));
+    if (!stream) { return NULL; }
+    memset(stream, 0, sizeof(JSON_Stream));
+    stream->callback = callback;
+    stream->user_data = user_data;
+    stream->state = StreamStart;
+    return stream;
+}
+
+int json_stream_feed(JSON_Stream *stream, const char *chunk, size_t length) {
+    const char *value_start = NULL; /* part of chunk that belongs to current element */
+    size_t i;
+    if (stream->state == StreamError) { return 0; }
+    if (stream->state == StreamValue) { value_start = chunk; }
+    for (i = 0; i < length; i++) {
+        char c = chunk[i];
+        switch (stream->state) {
+            case StreamStart:
+                if (isspace((unsigned char)c)) { break; }
+                if (c != '[') { stream->state = StreamError; return 0; }
+                stream->state = StreamArray;
+                break;
+            case StreamArray:
+                if (isspace((unsigned char)c) || c == ',') { break; }
+                if (c == ']') { stream->state = StreamDone; break; }
+                stream->state = StreamValue;
+                value_start = chunk + i;
+                /* fall through */
+            case StreamValue:
+                if (stream->in_string) {
+                    if (stream->escaped) { stream->escaped = 0; }
+                    else if (c == '\\') { stream->escaped = 1; }
+                    else if (c == '\"') { stream->in_string = 0; }
+                    break;
+                }
+                if (c == '\"') {
+                    stream->in_string = 1;
+                } else if (c == '{' || c == '[') {
+                    stream->depth++;
+                } else if ((c == '}' || c == ']') && stream->depth > 0) {
+                    if (--stream->depth > 0) { break; }
+                    /* object or array element is closed */
+                    if (json_stream_append(stream, value_start, chunk + i + 1 - value_start) == ERROR ||
+                        json_stream_emit(stream) == ERROR) {
+                        stream->state = StreamError;
+                        return 0;
+                    }
+                    value_start = NULL;
+                    stream->state = StreamArray;
+                } else if ((c == ',' || c == ']') && stream->depth == 0) {
+                    /* scalar element ends at the delimiter, which is not part of it */
+                    if (json_stream_append(stream, value_start, chunk + i - value_start) == ERROR ||
+                        json_stream_emit(stream) == ERROR) {
+                        stream->state = StreamError;
+                        return 0;
+                    }
+                    value_start = NULL;
+                    stream->state = c == ']' ? StreamDone : StreamArray;
+                }
+                break;
+            case StreamDone:
+                if (!isspace((unsigned char)c)) { stream->state = StreamError; return 0; }
+                break;
+            default:
+                return 0;
+        }
+    }
+    if (value_start && json_stream_append(stream, value_start, chunk + length - value_start) == ERROR) {
+        stream->state = StreamError;
+        return 0;
+    }
+    return 1;
+}
+
+int json_stream_finished(const JSON_Stream *stream) {
+    return stream->state == StreamDone;
+}
+
+void json_stream_free(JSON_Stream *stream) {
+    if (stream->buffer) { parson_free(stream->buffer); }
+    parson_free(stream);
+}
+
 /* JSON Object API */
 JSON_Value * json_object_get_value(const JSON_Object *object, const char *name) {
     return json_object_nget_value(object, name, strlen(name));
@@ -35,6 +35,7 @@ extern "C"
 typedef struct json_object_t JSON_Object;
 typedef struct json_array_t  JSON_Array;
 typedef struct json_value_t  JSON_Value;
+typedef struct json_stream_t JSON_Stream;
 
 typedef enum json_value_type {
     JSONError   = 0,
@@ -52,6 +53,21 @@ JSON_Value  * json_parse_file(const char *filename);
 /*  Parses first JSON value in a string, returns NULL in case of error */
 JSON_Value  * json_parse_string(const char *string);
 
+/*  Parses first JSON value in the first length bytes of string, which doesn't
+    have to be NUL terminated. Returns NULL in case of error */
+JSON_Value  * json_parse_nstring(const char *string, size_t length);
+
+/* Stream parser, for a top level array received in chunks. callback is called
+   with each element as soon as it is complete and owns the value. */
+typedef void (*JSON_Stream_Callback)(JSON_Value *value, void *user_data);
+
+JSON_Stream * json_stream_new     (JSON_Stream_Callback callback, void *user_data);
+/* returns 0 if chunk is not valid JSON */
+int           json_stream_feed    (JSON_Stream *stream, const char *chunk, size_t length);
+/* returns 1 if the top level array was closed */
+int           json_stream_finished(const JSON_Stream *stream);
+void          json_stream_free    (JSON_Stream *stream);
+
 /* JSON Object */
 JSON_Value  * json_object_get_value  (const JSON_Object *object, const char *name);
 const char  * json_object_get_string (const JSON_Object *object, const char *name);
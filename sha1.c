@@ -0,0 +1,832 @@
+/* Copyright 2010 by Yasuhiro Matsumoto
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * sha1/hmac
+ *
+ * block functions are chosen once at runtime: SHA extensions, the SSSE3
+ * message schedule (VEX encoded when AVX2 is there) or the portable code.
+ * sha1_multi runs up to SHA1_LANES messages in the lanes of one vector,
+ * which pays off for batches of short messages such as signature base
+ * strings, where the latency of a single hash can't be hidden.
+ */
+#include <string.h>
+#include "sha1.h"
+
+#if defined(__GNUC__) && (__GNUC__ >= 5 || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__)) && !defined(SHA1_NO_SIMD)
+# define SHA1_X86
+# include <cpuid.h>
+# include <immintrin.h>
+#endif
+
+#define SHA1_LANES (8)
+
+typedef void (*sha1_transform_func)(uint32_t state[5], const unsigned char* data, size_t blocks);
+
+#define GET_UINT32(n,b,i) {                   \
+  (n) = ( (uint32_t) (b)[(i)    ] << 24 )     \
+      | ( (uint32_t) (b)[(i) + 1] << 16 )     \
+      | ( (uint32_t) (b)[(i) + 2] <<  8 )     \
+      | ( (uint32_t) (b)[(i) + 3]       );    \
+}
+
+#define PUT_UINT32(n,b,i) {                     \
+  (b)[(i)    ] = (unsigned char) ( (n) >> 24 ); \
+  (b)[(i) + 1] = (unsigned char) ( (n) >> 16 ); \
+  (b)[(i) + 2] = (unsigned char) ( (n) >>  8 ); \
+  (b)[(i) + 3] = (unsigned char) ( (n)       ); \
+}
+
+static void
+sha1_transform_portable(uint32_t state[5], const unsigned char* data, size_t blocks) {
+  uint32_t temp, W[16], A, B, C, D, E;
+
+  while (blocks--) {
+    GET_UINT32( W[0],  data,  0 );
+    GET_UINT32( W[1],  data,  4 );
+    GET_UINT32( W[2],  data,  8 );
+    GET_UINT32( W[3],  data, 12 );
+    GET_UINT32( W[4],  data, 16 );
+    GET_UINT32( W[5],  data, 20 );
+    GET_UINT32( W[6],  data, 24 );
+    GET_UINT32( W[7],  data, 28 );
+    GET_UINT32( W[8],  data, 32 );
+    GET_UINT32( W[9],  data, 36 );
+    GET_UINT32( W[10], data, 40 );
+    GET_UINT32( W[11], data, 44 );
+    GET_UINT32( W[12], data, 48 );
+    GET_UINT32( W[13], data, 52 );
+    GET_UINT32( W[14], data, 56 );
+    GET_UINT32( W[15], data, 60 );
+
+#define S(x,n) ((x << n) | ((x & 0xFFFFFFFF) >> (32 - n)))
+
+#define R(t) \
+    (          \
+      temp = W[(t -  3) & 0x0F] ^ W[(t - 8) & 0x0F] ^     \
+      W[(t - 14) & 0x0F] ^ W[ t      & 0x0F],             \
+      ( W[t & 0x0F] = S(temp,1) )                         \
+    )
+
+#define P(a,b,c,d,e,x)                                  \
+    {                                                     \
+      e += S(a,5) + F(b,c,d) + K + x; b = S(b,30);        \
+    }
+
+    A = state[0];
+    B = state[1];
+    C = state[2];
+    D = state[3];
+    E = state[4];
+
+#define F(x,y,z) (z ^ (x & (y ^ z)))
+#define K 0x5A827999
+
+    P( A, B, C, D, E, W[0]  );
+    P( E, A, B, C, D, W[1]  );
+    P( D, E, A, B, C, W[2]  );
+    P( C, D, E, A, B, W[3]  );
+    P( B, C, D, E, A, W[4]  );
+    P( A, B, C, D, E, W[5]  );
+    P( E, A, B, C, D, W[6]  );
+    P( D, E, A, B, C, W[7]  );
+    P( C, D, E, A, B, W[8]  );
+    P( B, C, D, E, A, W[9]  );
+    P( A, B, C, D, E, W[10] );
+    P( E, A, B, C, D, W[11] );
+    P( D, E, A, B, C, W[12] );
+    P( C, D, E, A, B, W[13] );
+    P( B, C, D, E, A, W[14] );
+    P( A, B, C, D, E, W[15] );
+    P( E, A, B, C, D, R(16) );
+    P( D, E, A, B, C, R(17) );
+    P( C, D, E, A, B, R(18) );
+    P( B, C, D, E, A, R(19) );
+
+#undef K
+#undef F
+
+#define F(x,y,z) (x ^ y ^ z)
+#define K 0x6ED9EBA1
+
+    P( A, B, C, D, E, R(20) );
+    P( E, A, B, C, D, R(21) );
+    P( D, E, A, B, C, R(22) );
+    P( C, D, E, A, B, R(23) );
+    P( B, C, D, E, A, R(24) );
+    P( A, B, C, D, E, R(25) );
+    P( E, A, B, C, D, R(26) );
+    P( D, E, A, B, C, R(27) );
+    P( C, D, E, A, B, R(28) );
+    P( B, C, D, E, A, R(29) );
+    P( A, B, C, D, E, R(30) );
+    P( E, A, B, C, D, R(31) );
+    P( D, E, A, B, C, R(32) );
+    P( C, D, E, A, B, R(33) );
+    P( B, C, D, E, A, R(34) );
+    P( A, B, C, D, E, R(35) );
+    P( E, A, B, C, D, R(36) );
+    P( D, E, A, B, C, R(37) );
+    P( C, D, E, A, B, R(38) );
+    P( B, C, D, E, A, R(39) );
+
+#undef K
+#undef F
+
+#define F(x,y,z) ((x & y) | (z & (x | y)))
+#define K 0x8F1BBCDC
+
+    P( A, B, C, D, E, R(40) );
+    P( E, A, B, C, D, R(41) );
+    P( D, E, A, B, C, R(42) );
+    P( C, D, E, A, B, R(43) );
+    P( B, C, D, E, A, R(44) );
+    P( A, B, C, D, E, R(45) );
+    P( E, A, B, C, D, R(46) );
+    P( D, E, A, B, C, R(47) );
+    P( C, D, E, A, B, R(48) );
+    P( B, C, D, E, A, R(49) );
+    P( A, B, C, D, E, R(50) );
+    P( E, A, B, C, D, R(51) );
+    P( D, E, A, B, C, R(52) );
+    P( C, D, E, A, B, R(53) );
+    P( B, C, D, E, A, R(54) );
+    P( A, B, C, D, E, R(55) );
+    P( E, A, B, C, D, R(56) );
+    P( D, E, A, B, C, R(57) );
+    P( C, D, E, A, B, R(58) );
+    P( B, C, D, E, A, R(59) );
+
+#undef K
+#undef F
+
+#define F(x,y,z) (x ^ y ^ z)
+#define K 0xCA62C1D6
+
+    P( A, B, C, D, E, R(60) );
+    P( E, A, B, C, D, R(61) );
+    P( D, E, A, B, C, R(62) );
+    P( C, D, E, A, B, R(63) );
+    P( B, C, D, E, A, R(64) );
+    P( A, B, C, D, E, R(65) );
+    P( E, A, B, C, D, R(66) );
+    P( D, E, A, B, C, R(67) );
+    P( C, D, E, A, B, R(68) );
+    P( B, C, D, E, A, R(69) );
+    P( A, B, C, D, E, R(70) );
+    P( E, A, B, C, D, R(71) );
+    P( D, E, A, B, C, R(72) );
+    P( C, D, E, A, B, R(73) );
+    P( B, C, D, E, A, R(74) );
+    P( A, B, C, D, E, R(75) );
+    P( E, A, B, C, D, R(76) );
+    P( D, E, A, B, C, R(77) );
+    P( C, D, E, A, B, R(78) );
+    P( B, C, D, E, A, R(79) );
+
+#undef K
+#undef F
+
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+    state[4] += E;
+
+    data += 64;
+  }
+}
+
+#undef S
+#undef R
+#undef P
+
+#define ROL(x,n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#ifdef SHA1_X86
+/* 80 rounds over W[t] + K already summed up in wk */
+#define SHA1_ROUND(a,b,c,d,e,f,t)                   \
+  {                                                 \
+    e += ROL(a,5) + f(b,c,d) + wk[t]; b = ROL(b,30); \
+  }
+#define SHA1_F0(x,y,z) (z ^ (x & (y ^ z)))
+#define SHA1_F1(x,y,z) (x ^ y ^ z)
+#define SHA1_F2(x,y,z) ((x & y) | (z & (x | y)))
+
+static const uint32_t sha1_k[4] = {
+  0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6
+};
+
+/* message schedule four words per instruction, rounds stay scalar.
+   W[t+3] depends on W[t] in the first recurrence, that lane is fixed up
+   afterwards; from t = 32 on W[t] = (W[t-6]^W[t-16]^W[t-28]^W[t-32]) <<< 2
+   has no such dependency within a vector. each vector is made two groups
+   of rounds ahead of its use, so both run side by side. */
+#define SHA1_VROL(x,n) _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - (n)))
+#define SHA1_WK(i)                                                  \
+  _mm_store_si128((__m128i*) (wk + (i) * 4),                        \
+      _mm_add_epi32(w[i], _mm_set1_epi32((int) sha1_k[(i) / 5])))
+#define SHA1_SCHEDULE(i)                                            \
+  {                                                                 \
+    if ((i) < 8) {                                                  \
+      __m128i x = _mm_xor_si128(                                    \
+          _mm_xor_si128(w[(i) - 4], _mm_alignr_epi8(w[(i) - 3], w[(i) - 4], 8)), \
+          _mm_xor_si128(w[(i) - 2], _mm_srli_si128(w[(i) - 1], 4))); \
+      x = SHA1_VROL(x, 1);                                          \
+      w[i] = _mm_xor_si128(x, SHA1_VROL(_mm_slli_si128(x, 12), 1)); \
+    } else {                                                        \
+      __m128i x = _mm_xor_si128(                                    \
+          _mm_xor_si128(_mm_alignr_epi8(w[(i) - 1], w[(i) - 2], 8), w[(i) - 4]), \
+          _mm_xor_si128(w[(i) - 7], w[(i) - 8]));                   \
+      w[i] = SHA1_VROL(x, 2);                                       \
+    }                                                               \
+    SHA1_WK(i);                                                     \
+  }
+
+static inline __attribute__((always_inline, target("ssse3"))) void
+sha1_schedule_body(uint32_t state[5], const unsigned char* data, size_t blocks) {
+  const __m128i swap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  uint32_t wk[80] __attribute__((aligned(16)));
+  uint32_t A, B, C, D, E;
+  __m128i w[20];
+
+  while (blocks--) {
+    w[0] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data +  0)), swap);
+    w[1] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + 16)), swap);
+    w[2] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + 32)), swap);
+    w[3] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + 48)), swap);
+    SHA1_WK(0);
+    SHA1_WK(1);
+    SHA1_WK(2);
+    SHA1_WK(3);
+
+    A = state[0];
+    B = state[1];
+    C = state[2];
+    D = state[3];
+    E = state[4];
+
+    SHA1_ROUND(A, B, C, D, E, SHA1_F0,  0);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F0,  1);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F0,  2);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F0,  3);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F0,  4);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F0,  5);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F0,  6);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F0,  7);
+    SHA1_SCHEDULE(4);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F0,  8);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F0,  9);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F0, 10);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F0, 11);
+    SHA1_SCHEDULE(5);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F0, 12);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F0, 13);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F0, 14);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F0, 15);
+    SHA1_SCHEDULE(6);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F0, 16);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F0, 17);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F0, 18);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F0, 19);
+    SHA1_SCHEDULE(7);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F1, 20);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F1, 21);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F1, 22);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F1, 23);
+    SHA1_SCHEDULE(8);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F1, 24);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F1, 25);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F1, 26);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F1, 27);
+    SHA1_SCHEDULE(9);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F1, 28);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F1, 29);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F1, 30);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F1, 31);
+    SHA1_SCHEDULE(10);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F1, 32);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F1, 33);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F1, 34);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F1, 35);
+    SHA1_SCHEDULE(11);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F1, 36);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F1, 37);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F1, 38);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F1, 39);
+    SHA1_SCHEDULE(12);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F2, 40);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F2, 41);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F2, 42);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F2, 43);
+    SHA1_SCHEDULE(13);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F2, 44);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F2, 45);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F2, 46);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F2, 47);
+    SHA1_SCHEDULE(14);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F2, 48);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F2, 49);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F2, 50);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F2, 51);
+    SHA1_SCHEDULE(15);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F2, 52);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F2, 53);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F2, 54);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F2, 55);
+    SHA1_SCHEDULE(16);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F2, 56);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F2, 57);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F2, 58);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F2, 59);
+    SHA1_SCHEDULE(17);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F1, 60);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F1, 61);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F1, 62);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F1, 63);
+    SHA1_SCHEDULE(18);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F1, 64);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F1, 65);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F1, 66);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F1, 67);
+    SHA1_SCHEDULE(19);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F1, 68);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F1, 69);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F1, 70);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F1, 71);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F1, 72);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F1, 73);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F1, 74);
+    SHA1_ROUND(A, B, C, D, E, SHA1_F1, 75);
+    SHA1_ROUND(E, A, B, C, D, SHA1_F1, 76);
+    SHA1_ROUND(D, E, A, B, C, SHA1_F1, 77);
+    SHA1_ROUND(C, D, E, A, B, SHA1_F1, 78);
+    SHA1_ROUND(B, C, D, E, A, SHA1_F1, 79);
+
+    state[0] += A;
+    state[1] += B;
+    state[2] += C;
+    state[3] += D;
+    state[4] += E;
+    data += 64;
+  }
+}
+
+static __attribute__((target("ssse3"))) void
+sha1_transform_ssse3(uint32_t state[5], const unsigned char* data, size_t blocks) {
+  sha1_schedule_body(state, data, blocks);
+}
+
+static __attribute__((target("avx2"))) void
+sha1_transform_avx2(uint32_t state[5], const unsigned char* data, size_t blocks) {
+  sha1_schedule_body(state, data, blocks);
+}
+
+/* four rounds per sha1rnds4. g is the group of four rounds, msg[g % 4]
+   holds its words and e[g % 2] the E value it takes. */
+#define SHA1NI_GROUP(g)                                                      \
+  {                                                                          \
+    e[(g) % 2] = _mm_sha1nexte_epu32(e[(g) % 2], msg[(g) % 4]);              \
+    e[((g) + 1) % 2] = abcd;                                                 \
+    if ((g) >= 3 && (g) <= 18)                                               \
+      msg[((g) + 1) % 4] = _mm_sha1msg2_epu32(msg[((g) + 1) % 4], msg[(g) % 4]); \
+    abcd = _mm_sha1rnds4_epu32(abcd, e[(g) % 2], (g) / 5);                   \
+    if ((g) <= 16)                                                           \
+      msg[((g) + 3) % 4] = _mm_sha1msg1_epu32(msg[((g) + 3) % 4], msg[(g) % 4]); \
+    if ((g) >= 2 && (g) <= 17)                                               \
+      msg[((g) + 2) % 4] = _mm_xor_si128(msg[((g) + 2) % 4], msg[(g) % 4]);  \
+  }
+
+static __attribute__((target("sha,sse4.1"))) void
+sha1_transform_shani(uint32_t state[5], const unsigned char* data, size_t blocks) {
+  const __m128i swap = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+  __m128i abcd, abcd_save, e_save;
+  __m128i e[2], msg[4];
+
+  abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*) state), 0x1B);
+  e[0] = _mm_set_epi32((int) state[4], 0, 0, 0);
+
+  while (blocks--) {
+    abcd_save = abcd;
+    e_save = e[0];
+
+    msg[0] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data +  0)), swap);
+    msg[1] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + 16)), swap);
+    msg[2] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + 32)), swap);
+    msg[3] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data + 48)), swap);
+
+    /* first group adds E instead of deriving it */
+    e[0] = _mm_add_epi32(e[0], msg[0]);
+    e[1] = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e[0], 0);
+
+    SHA1NI_GROUP(1);  SHA1NI_GROUP(2);  SHA1NI_GROUP(3);  SHA1NI_GROUP(4);
+    SHA1NI_GROUP(5);  SHA1NI_GROUP(6);  SHA1NI_GROUP(7);  SHA1NI_GROUP(8);
+    SHA1NI_GROUP(9);  SHA1NI_GROUP(10); SHA1NI_GROUP(11); SHA1NI_GROUP(12);
+    SHA1NI_GROUP(13); SHA1NI_GROUP(14); SHA1NI_GROUP(15); SHA1NI_GROUP(16);
+    SHA1NI_GROUP(17); SHA1NI_GROUP(18); SHA1NI_GROUP(19);
+
+    e[0] = _mm_sha1nexte_epu32(e[0], e_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+    data += 64;
+  }
+
+  _mm_storeu_si128((__m128i*) state, _mm_shuffle_epi32(abcd, 0x1B));
+  state[4] = (uint32_t) _mm_extract_epi32(e[0], 3);
+}
+
+/* one lane per message, GCC splits the vectors in halves without AVX2 */
+typedef uint32_t sha1_lanes_vector __attribute__((vector_size(SHA1_LANES * 4)));
+
+#define VROL(x,n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static inline __attribute__((always_inline)) void
+sha1_lanes_body(sha1_lanes_vector state[5], const unsigned char* const data[SHA1_LANES]) {
+  sha1_lanes_vector W[16], A, B, C, D, E, T;
+  int t, n;
+
+  for (t = 0; t < 16; t++)
+    for (n = 0; n < SHA1_LANES; n++) {
+      uint32_t word;
+      GET_UINT32(word, data[n], t * 4);
+      W[t][n] = word;
+    }
+
+  A = state[0];
+  B = state[1];
+  C = state[2];
+  D = state[3];
+  E = state[4];
+
+  for (t = 0; t < 80; t++) {
+    sha1_lanes_vector f, w;
+    if (t < 16)
+      w = W[t];
+    else {
+      w = W[(t - 3) & 15] ^ W[(t - 8) & 15] ^ W[(t - 14) & 15] ^ W[t & 15];
+      w = W[t & 15] = VROL(w, 1);
+    }
+    if (t < 20)
+      f = D ^ (B & (C ^ D));
+    else if (t < 40 || t >= 60)
+      f = B ^ C ^ D;
+    else
+      f = (B & C) | (D & (B | C));
+    T = VROL(A, 5) + f + E + w + sha1_k[t / 20];
+    E = D;
+    D = C;
+    C = VROL(B, 30);
+    B = A;
+    A = T;
+  }
+
+  state[0] += A;
+  state[1] += B;
+  state[2] += C;
+  state[3] += D;
+  state[4] += E;
+}
+
+static void
+sha1_lanes_sse2(sha1_lanes_vector state[5], const unsigned char* const data[SHA1_LANES]) {
+  sha1_lanes_body(state, data);
+}
+
+static __attribute__((target("avx2"))) void
+sha1_lanes_avx2(sha1_lanes_vector state[5], const unsigned char* const data[SHA1_LANES]) {
+  sha1_lanes_body(state, data);
+}
+
+static unsigned int
+sha1_cpu_features() {
+  unsigned int a, b, c, d, ecx1;
+  unsigned int features = 1 << SHA1_PORTABLE;
+
+  if (!__get_cpuid(1, &a, &b, &ecx1, &d)) return features;
+  if (ecx1 & (1 << 9)) features |= 1 << SHA1_SSSE3;
+  if (__get_cpuid_max(0, NULL) < 7) return features;
+  __cpuid_count(7, 0, a, b, c, d);
+  /* SHA extensions come with SSE4.1 on every cpu, check anyway */
+  if ((b & (1 << 29)) && (ecx1 & (1 << 19)) && (features & (1 << SHA1_SSSE3)))
+    features |= 1 << SHA1_SHANI;
+  /* AVX2 needs the OS to save ymm state: OSXSAVE, AVX and XCR0 bits 1,2 */
+  if ((b & (1 << 5)) && (ecx1 & (1 << 27)) && (ecx1 & (1 << 28))) {
+    unsigned int xcr0, xcr0_high;
+    __asm__ __volatile__("xgetbv" : "=a"(xcr0), "=d"(xcr0_high) : "c"(0));
+    if ((xcr0 & 6) == 6) features |= 1 << SHA1_AVX2;
+  }
+  return features;
+}
+#endif
+
+static const char* sha1_impl_names[SHA1_IMPLS] = {
+  "portable", "ssse3", "avx2", "sha-ni"
+};
+
+static const sha1_transform_func sha1_transforms[SHA1_IMPLS] = {
+  sha1_transform_portable,
+#ifdef SHA1_X86
+  sha1_transform_ssse3,
+  sha1_transform_avx2,
+  sha1_transform_shani,
+#else
+  NULL, NULL, NULL,
+#endif
+};
+
+/* SHA1_IMPLS until the cpu was asked */
+static SHA1_Impl sha1_impl = SHA1_IMPLS;
+static sha1_transform_func sha1_transform = NULL;
+
+const char*
+sha1_impl_name(SHA1_Impl impl) {
+  return impl < SHA1_IMPLS ? sha1_impl_names[impl] : "auto";
+}
+
+int
+sha1_impl_supported(SHA1_Impl impl) {
+  static unsigned int features = 0;
+  if (impl >= SHA1_IMPLS) return 0;
+  if (!features) {
+#ifdef SHA1_X86
+    features = sha1_cpu_features();
+#else
+    features = 1 << SHA1_PORTABLE;
+#endif
+  }
+  return (features >> impl) & 1;
+}
+
+SHA1_Impl
+sha1_use_impl(SHA1_Impl impl) {
+  static const SHA1_Impl fastest[] = { SHA1_SHANI, SHA1_AVX2, SHA1_SSSE3, SHA1_PORTABLE };
+  int n;
+
+  if (impl >= SHA1_IMPLS || !sha1_impl_supported(impl)) {
+    for (n = 0; !sha1_impl_supported(fastest[n]); n++);
+    impl = fastest[n];
+  }
+  /* the race of two first calls writes the same values */
+  sha1_transform = sha1_transforms[impl];
+  sha1_impl = impl;
+  return impl;
+}
+
+SHA1_Impl
+sha1_get_impl() {
+  return sha1_impl < SHA1_IMPLS ? sha1_impl : sha1_use_impl(SHA1_IMPLS);
+}
+
+static void
+sha1_process(sha1_context* ctx, const unsigned char* data, size_t blocks) {
+  if (!sha1_transform) sha1_use_impl(SHA1_IMPLS);
+  sha1_transform(ctx->state, data, blocks);
+}
+
+void
+sha1_starts(sha1_context* ctx) {
+  ctx->total[0] = 0;
+  ctx->total[1] = 0;
+
+  ctx->state[0] = 0x67452301;
+  ctx->state[1] = 0xEFCDAB89;
+  ctx->state[2] = 0x98BADCFE;
+  ctx->state[3] = 0x10325476;
+  ctx->state[4] = 0xC3D2E1F0;
+}
+
+void
+sha1_update(sha1_context* ctx, const unsigned char* input, size_t length) {
+  uint32_t left, fill;
+
+  if (!length)
+    return;
+
+  left = ctx->total[0] & 0x3F;
+  fill = 64 - left;
+
+  ctx->total[0] += (uint32_t) length;
+  if (ctx->total[0] < (uint32_t) length)
+    ctx->total[1]++;
+  ctx->total[1] += (uint32_t) ((uint64_t) length >> 32);
+
+  if (left && length >= fill) {
+    memcpy((void*)(ctx->buffer + left), (void*) input, fill);
+    sha1_process(ctx, ctx->buffer, 1);
+    length -= fill;
+    input  += fill;
+    left = 0;
+  }
+
+  /* whole blocks straight from input, in one call */
+  if (length >= 64) {
+    sha1_process(ctx, input, length / 64);
+    input  += length & ~(size_t) 0x3F;
+    length &= 0x3F;
+  }
+
+  if (length)
+    memcpy((void*)(ctx->buffer + left), (void *) input, length );
+}
+
+static const unsigned char
+sha1_padding[64] = {
+  0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+void
+sha1_finish(sha1_context* ctx, unsigned char digest[20]) {
+  uint32_t last, padn;
+  uint32_t high, low;
+  unsigned char msglen[8];
+
+  high = (ctx->total[0] >> 29)
+      | (ctx->total[1] <<  3);
+  low  = (ctx->total[0] <<  3);
+
+  PUT_UINT32(high, msglen, 0);
+  PUT_UINT32(low,  msglen, 4);
+
+  last = ctx->total[0] & 0x3F;
+  padn = (last < 56) ? (56 - last) : (120 - last);
+
+  sha1_update(ctx, sha1_padding, padn);
+  sha1_update(ctx, msglen, 8);
+
+  PUT_UINT32(ctx->state[0], digest,  0);
+  PUT_UINT32(ctx->state[1], digest,  4);
+  PUT_UINT32(ctx->state[2], digest,  8);
+  PUT_UINT32(ctx->state[3], digest, 12);
+  PUT_UINT32(ctx->state[4], digest, 16);
+}
+
+unsigned char*
+sha1(const unsigned char* input, size_t size, unsigned char* digest) {
+  sha1_context ctx;
+  sha1_starts(&ctx);
+  sha1_update(&ctx, input, size);
+  sha1_finish(&ctx, digest);
+  return digest;
+}
+
+#ifdef SHA1_X86
+/* last one or two blocks of a message, with padding and length */
+static size_t
+sha1_tail(const unsigned char* input, size_t size, unsigned char tail[128]) {
+  size_t left = size & 0x3F;
+  size_t blocks = left < 56 ? 1 : 2;
+  uint64_t bits = (uint64_t) size << 3;
+
+  memset(tail, 0, 128);
+  memcpy(tail, input + size - left, left);
+  tail[left] = 0x80;
+  PUT_UINT32((uint32_t) (bits >> 32), tail, blocks * 64 - 8);
+  PUT_UINT32((uint32_t) bits, tail, blocks * 64 - 4);
+  return blocks;
+}
+#endif
+
+void
+sha1_multi(const unsigned char* const* inputs, const size_t* sizes,
+        unsigned char (*digests)[20], int count) {
+#ifdef SHA1_X86
+  SHA1_Impl impl = sha1_get_impl();
+  /* a lane keeps hashing a zero block once its message is done */
+  static const unsigned char idle[64] = {0};
+  unsigned char tails[SHA1_LANES][128];
+  const unsigned char* data[SHA1_LANES];
+  size_t full[SHA1_LANES], total[SHA1_LANES], most;
+  sha1_lanes_vector state[5];
+  size_t block;
+  int lanes, n, m;
+
+  /* one message after another is faster on SHA extensions, and as fast
+     on scalar code */
+  if (impl == SHA1_SHANI || impl == SHA1_PORTABLE) {
+    for (n = 0; n < count; n++)
+      sha1(inputs[n], sizes[n], digests[n]);
+    return;
+  }
+
+  for (n = 0; n < count; n += SHA1_LANES) {
+    lanes = count - n < SHA1_LANES ? count - n : SHA1_LANES;
+    most = 0;
+    for (m = 0; m < SHA1_LANES; m++) {
+      if (m < lanes) {
+        full[m] = sizes[n + m] / 64;
+        total[m] = full[m] + sha1_tail(inputs[n + m], sizes[n + m], tails[m]);
+      } else
+        full[m] = total[m] = 0;
+      if (total[m] > most) most = total[m];
+    }
+    for (m = 0; m < 5; m++) {
+      static const uint32_t init[5] = {
+        0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+      };
+      int lane;
+      for (lane = 0; lane < SHA1_LANES; lane++)
+        state[m][lane] = init[m];
+    }
+    for (block = 0; block < most; block++) {
+      for (m = 0; m < SHA1_LANES; m++) {
+        if (block < full[m])
+          data[m] = inputs[n + m] + block * 64;
+        else if (block < total[m])
+          data[m] = tails[m] + (block - full[m]) * 64;
+        else
+          data[m] = idle;
+      }
+      if (impl == SHA1_AVX2)
+        sha1_lanes_avx2(state, data);
+      else
+        sha1_lanes_sse2(state, data);
+      for (m = 0; m < lanes; m++) {
+        int word;
+        if (block + 1 != total[m]) continue;
+        for (word = 0; word < 5; word++)
+          PUT_UINT32(state[word][m], digests[n + m], word * 4);
+      }
+    }
+  }
+#else
+  int n;
+  for (n = 0; n < count; n++)
+    sha1(inputs[n], sizes[n], digests[n]);
+#endif
+}
+
+void
+hmac_key_init(hmac_key* hkey, const unsigned char* key, size_t keylen) {
+  int i;
+  unsigned char ipad[64];
+  unsigned char opad[64];
+  unsigned char keydigest[20];
+
+  if (keylen > 64) {
+    sha1(key, keylen, keydigest);
+    key = keydigest;
+    keylen = 20;
+  }
+  memset(ipad, 0, sizeof(ipad));
+  memcpy(ipad, key, keylen);
+  memcpy(opad, ipad, sizeof(opad));
+
+  for (i = 0; i < 64; i++) {
+    ipad[i] ^= 0x36;
+    opad[i] ^= 0x5c;
+  }
+
+  sha1_starts(&hkey->inner);
+  sha1_update(&hkey->inner, ipad, 64);
+  sha1_starts(&hkey->outer);
+  sha1_update(&hkey->outer, opad, 64);
+}
+
+unsigned char*
+hmac_key_sign(const hmac_key* hkey, const unsigned char* data, size_t datalen, unsigned char* digest) {
+  sha1_context ctx;
+  unsigned char inner[20];
+
+  ctx = hkey->inner;
+  sha1_update(&ctx, data, datalen);
+  sha1_finish(&ctx, inner);
+
+  ctx = hkey->outer;
+  sha1_update(&ctx, inner, 20);
+  sha1_finish(&ctx, digest);
+
+  return digest;
+}
+
+unsigned char*
+hmac(const unsigned char* key, size_t keylen, const unsigned char* data, size_t datalen, unsigned char* digest) {
+  hmac_key hkey;
+  hmac_key_init(&hkey, key, keylen);
+  return hmac_key_sign(&hkey, data, datalen, digest);
+}
+
+/* vim:set et sw=4: */
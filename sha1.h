@@ -0,0 +1,83 @@
+/* Copyright 2010 by Yasuhiro Matsumoto
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef gtktweeter_sha1_h
+#define gtktweeter_sha1_h
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  uint32_t total[2];
+  uint32_t state[5];
+  unsigned char buffer[64];
+} sha1_context;
+
+/* sha1 states after the ipad and opad blocks, the part of a hmac which
+   depends on the key only */
+typedef struct {
+  sha1_context inner;
+  sha1_context outer;
+} hmac_key;
+
+/* block functions, picked at runtime from what the cpu supports */
+typedef enum {
+  SHA1_PORTABLE,
+  SHA1_SSSE3,   /* message schedule four words at a time */
+  SHA1_AVX2,    /* same with VEX encoding, 8 lanes for sha1_multi */
+  SHA1_SHANI,   /* SHA extensions */
+  SHA1_IMPLS
+} SHA1_Impl;
+
+void            sha1_starts(sha1_context* ctx);
+void            sha1_update(sha1_context* ctx, const unsigned char* input, size_t length);
+void            sha1_finish(sha1_context* ctx, unsigned char digest[20]);
+unsigned char * sha1       (const unsigned char* input, size_t size, unsigned char* digest);
+
+/* digests of count independent messages. they are hashed side by side in
+   SIMD lanes where the cpu allows it, one after another otherwise. */
+void            sha1_multi (const unsigned char* const* inputs, const size_t* sizes,
+                            unsigned char (*digests)[20], int count);
+
+void            hmac_key_init(hmac_key* hkey, const unsigned char* key, size_t keylen);
+unsigned char * hmac_key_sign(const hmac_key* hkey, const unsigned char* data, size_t datalen,
+                              unsigned char* digest);
+unsigned char * hmac         (const unsigned char* key, size_t keylen,
+                              const unsigned char* data, size_t datalen, unsigned char* digest);
+
+/* the fastest supported one is used unless another is forced, which is
+   meant for benchmarks and tests. returns the impl in use. */
+const char    * sha1_impl_name     (SHA1_Impl impl);
+int             sha1_impl_supported(SHA1_Impl impl);
+SHA1_Impl       sha1_use_impl      (SHA1_Impl impl);
+SHA1_Impl       sha1_get_impl      (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,173 @@
+/* Copyright 2010 by Yasuhiro Matsumoto
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * sha1 benchmark
+ *
+ * hashes the same inputs with every block function the cpu supports,
+ * one message at a time and through sha1_multi, after checking that all
+ * of them agree with the portable code. the best of BENCH_REPEAT runs is
+ * shown, which keeps noise of other processes out:
+ *
+ *   sha1bench [seconds per case]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sha1.h"
+
+#define BENCH_TIME   (0.2)
+#define BENCH_REPEAT (5)
+#define BENCH_BATCH  (64)
+
+/* nonce input, a signature base string, a long base string, bulk */
+static const size_t bench_sizes[] = { 20, 300, 4096, 65536 };
+#define BENCH_SIZES ((int) (sizeof(bench_sizes) / sizeof(bench_sizes[0])))
+
+static double
+now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* nanoseconds per message, best of BENCH_REPEAT runs of span seconds */
+static double
+bench_single(const unsigned char* input, size_t size, double span) {
+  unsigned char digest[20];
+  double best = 0;
+  int repeat;
+
+  for (repeat = 0; repeat < BENCH_REPEAT; repeat++) {
+    double start = now(), elapsed;
+    long ops = 0, n, round = 16;
+    do {
+      for (n = 0; n < round; n++)
+        sha1(input, size, digest);
+      ops += round;
+      round *= 2;
+      elapsed = now() - start;
+    } while (elapsed < span / BENCH_REPEAT);
+    if (!repeat || elapsed * 1e9 / ops < best) best = elapsed * 1e9 / ops;
+  }
+  return best;
+}
+
+static double
+bench_multi(const unsigned char** inputs, const size_t* sizes, double span) {
+  unsigned char digests[BENCH_BATCH][20];
+  double best = 0;
+  int repeat;
+
+  for (repeat = 0; repeat < BENCH_REPEAT; repeat++) {
+    double start = now(), elapsed;
+    long ops = 0, n, round = 1;
+    do {
+      for (n = 0; n < round; n++)
+        sha1_multi(inputs, sizes, digests, BENCH_BATCH);
+      ops += round * BENCH_BATCH;
+      round *= 2;
+      elapsed = now() - start;
+    } while (elapsed < span / BENCH_REPEAT);
+    if (!repeat || elapsed * 1e9 / ops < best) best = elapsed * 1e9 / ops;
+  }
+  return best;
+}
+
+static int
+verify(const unsigned char* buf) {
+  const unsigned char* inputs[BENCH_BATCH];
+  size_t sizes[BENCH_BATCH];
+  unsigned char digests[BENCH_BATCH][20];
+  unsigned char expect[BENCH_BATCH][20];
+  unsigned char digest[20];
+  int impl, n, bad = 0;
+
+  for (n = 0; n < BENCH_BATCH; n++) {
+    inputs[n] = buf + n;
+    sizes[n] = (size_t) n * 67 % 1000;
+  }
+  sha1_use_impl(SHA1_PORTABLE);
+  for (n = 0; n < BENCH_BATCH; n++)
+    sha1(inputs[n], sizes[n], expect[n]);
+  for (impl = 0; impl < SHA1_IMPLS; impl++) {
+    if (!sha1_impl_supported(impl)) continue;
+    sha1_use_impl(impl);
+    sha1_multi(inputs, sizes, digests, BENCH_BATCH);
+    for (n = 0; n < BENCH_BATCH; n++) {
+      sha1(inputs[n], sizes[n], digest);
+      if (memcmp(digest, expect[n], 20) || memcmp(digests[n], expect[n], 20)) {
+        fprintf(stderr, "%s: wrong digest for %d bytes\n",
+                sha1_impl_name(impl), (int) sizes[n]);
+        bad++;
+        break;
+      }
+    }
+  }
+  return bad == 0;
+}
+
+int
+main(int argc, char* argv[]) {
+  double span = argc > 1 ? atof(argv[1]) : BENCH_TIME;
+  size_t most = bench_sizes[BENCH_SIZES - 1] + BENCH_BATCH;
+  unsigned char* buf = (unsigned char*) malloc(most);
+  const unsigned char* inputs[BENCH_BATCH];
+  size_t sizes[BENCH_BATCH];
+  size_t n;
+  int impl, s;
+
+  if (!buf) return 1;
+  for (n = 0; n < most; n++)
+    buf[n] = (unsigned char) (n * 131 + 7);
+  if (!verify(buf)) return 1;
+
+  printf("%-10s %8s %12s %10s %12s %10s\n",
+          "impl", "bytes", "ns/op", "MB/s", "multi ns/op", "MB/s");
+  for (impl = 0; impl < SHA1_IMPLS; impl++) {
+    if (!sha1_impl_supported(impl)) {
+      printf("%-10s (not supported by this cpu)\n", sha1_impl_name(impl));
+      continue;
+    }
+    sha1_use_impl(impl);
+    for (s = 0; s < BENCH_SIZES; s++) {
+      double single, multi;
+      for (n = 0; n < BENCH_BATCH; n++) {
+        inputs[n] = buf + n;
+        sizes[n] = bench_sizes[s];
+      }
+      single = bench_single(buf, bench_sizes[s], span);
+      multi = bench_multi(inputs, sizes, span);
+      printf("%-10s %8d %12.1f %10.1f %12.1f %10.1f\n",
+              sha1_impl_name(impl), (int) bench_sizes[s],
+              single, bench_sizes[s] * 1e3 / single,
+              multi, bench_sizes[s] * 1e3 / multi);
+    }
+  }
+  printf("default: %s\n", sha1_impl_name(sha1_use_impl(SHA1_IMPLS)));
+  free(buf);
+  return 0;
+}
+
+/* vim:set et sw=4: */
@@ -0,0 +1,218 @@
+/* Copyright 2010 by Yasuhiro Matsumoto
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * stand-in for the streaming API
+ *
+ * serves a synthetic, newline delimited stream of statuses on every
+ * request, in the chunked format of userstream.twitter.com, so the
+ * streaming timeline can be tried without network access:
+ *
+ *   streamserver -p 8090 -r 5 -d 60
+ *
+ * and in the gtktweeter config:
+ *
+ *   streaming=1
+ *   stream_url=http://127.0.0.1:8090/1.1/user.json
+ *
+ * -r is statuses per second, -d closes each stream after that many seconds
+ * to exercise reconnects, -u is the number of distinct authors.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define STREAM_PORT        (8090)
+#define STREAM_RATE        (1.0)
+#define STREAM_USERS       (20)
+#define STREAM_KEEPALIVE   (30)
+#define TWEPOCH            (1288834974657ULL)
+
+static double rate = STREAM_RATE;
+static int users = STREAM_USERS;
+static int drop = 0;
+
+static double
+now() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* one chunk of chunked transfer encoding, 0 when the client is gone */
+static int
+send_chunk(int fd, const char* data, size_t size) {
+  char head[32];
+  int len = snprintf(head, sizeof(head), "%lx\r\n", (unsigned long) size);
+  if (write(fd, head, len) != len) return 0;
+  if (size && write(fd, data, size) != (ssize_t) size) return 0;
+  return write(fd, "\r\n", 2) == 2;
+}
+
+/* ids grow with time like snowflake ids do */
+static unsigned long long
+get_status_id(double t, unsigned int seq) {
+  unsigned long long ms = (unsigned long long) (t * 1000);
+  return ((ms - TWEPOCH) << 22) | (seq & 0xfff);
+}
+
+static int
+send_friends(int fd) {
+  char buf[BUFSIZ];
+  int len = snprintf(buf, sizeof(buf), "{\"friends\":[");
+  int n;
+  for (n = 0; n < users && len < (int) sizeof(buf) - 32; n++)
+    len += snprintf(buf + len, sizeof(buf) - len, "%s%d", n ? "," : "", n + 1);
+  len += snprintf(buf + len, sizeof(buf) - len, "]}\r\n");
+  return send_chunk(fd, buf, len);
+}
+
+static int
+send_status(int fd, unsigned int seq) {
+  char buf[BUFSIZ];
+  char date[64];
+  double t = now();
+  time_t sec = (time_t) t;
+  int user = rand() % users + 1;
+  int mention = rand() % users + 1;
+  unsigned long long id = get_status_id(t, seq);
+  int len;
+
+  strftime(date, sizeof(date), "%a %b %d %H:%M:%S +0000 %Y", gmtime(&sec));
+  len = snprintf(buf, sizeof(buf),
+          "{\"id\":%llu,\"id_str\":\"%llu\","
+          "\"created_at\":\"%s\","
+          "\"text\":\"synthetic status %u for @user%d\","
+          "\"favorited\":false,\"retweeted\":false,"
+          "\"user\":{\"id\":%d,\"id_str\":\"%d\","
+          "\"name\":\"User %d\",\"screen_name\":\"user%d\","
+          "\"profile_image_url\":\"http://127.0.0.1/user%d.png\"}}\r\n",
+          id, id, date, seq, mention, user, user, user, user, user);
+  return send_chunk(fd, buf, len);
+}
+
+static void
+serve(int fd) {
+  char buf[BUFSIZ];
+  const char* head =
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: application/json\r\n"
+      "Transfer-Encoding: chunked\r\n"
+      "\r\n";
+  double start = now();
+  double next_status = start;
+  double next_keepalive = start + STREAM_KEEPALIVE;
+  unsigned int seq = 0;
+
+  /* request itself doesn't matter, read its head and stream */
+  if (read(fd, buf, sizeof(buf)) <= 0) return;
+  if (write(fd, head, strlen(head)) != (ssize_t) strlen(head)) return;
+  if (!send_friends(fd)) return;
+
+  while (!drop || now() - start < drop) {
+    double t = now();
+    double wait;
+    if (rate > 0 && t >= next_status) {
+      if (!send_status(fd, seq++)) return;
+      next_status += 1.0 / rate;
+      next_keepalive = t + STREAM_KEEPALIVE;
+      continue;
+    }
+    if (t >= next_keepalive) {
+      if (!send_chunk(fd, "\r\n", 2)) return;
+      next_keepalive = t + STREAM_KEEPALIVE;
+    }
+    wait = next_keepalive - t;
+    if (rate > 0 && next_status - t < wait) wait = next_status - t;
+    if (wait > 0) usleep((useconds_t) (wait * 1e6));
+  }
+  /* end of a chunked body, the client has to reconnect */
+  send_chunk(fd, NULL, 0);
+}
+
+int
+main(int argc, char* argv[]) {
+  struct sockaddr_in addr;
+  int port = STREAM_PORT;
+  int on = 1;
+  int sock;
+  int c;
+
+  while ((c = getopt(argc, argv, "p:r:u:d:")) != -1) {
+    switch (c) {
+    case 'p': port = atoi(optarg); break;
+    case 'r': rate = atof(optarg); break;
+    case 'u': users = atoi(optarg); break;
+    case 'd': drop = atoi(optarg); break;
+    default:
+      fprintf(stderr, "usage: %s [-p port] [-r statuses/sec] [-u users] [-d seconds]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (users < 1) users = 1;
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGCHLD, SIG_IGN);
+  srand((unsigned int) time(0));
+
+  sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0) {
+    perror("socket");
+    return 1;
+  }
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(sock, (struct sockaddr*) &addr, sizeof(addr)) < 0 || listen(sock, 8) < 0) {
+    perror("bind");
+    return 1;
+  }
+  fprintf(stderr, "streaming %.2f statuses/sec on http://127.0.0.1:%d/\n", rate, port);
+
+  while (1) {
+    int fd = accept(sock, NULL, NULL);
+    if (fd < 0) continue;
+    /* one process per stream */
+    if (fork() == 0) {
+      close(sock);
+      srand((unsigned int) getpid());
+      serve(fd);
+      close(fd);
+      _exit(0);
+    }
+    close(fd);
+  }
+  return 0;
+}
+
+/* vim:set et sw=4: */
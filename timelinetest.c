@@ -0,0 +1,104 @@
+/* Copyright 2010 by Yasuhiro Matsumoto
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+ * REGENTS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * timeline tests
+ *
+ * built with gtktweeter.c and GTKTWEETER_TEST, which calls
+ * timeline_page_insert_hook while the gdk lock is dropped. "make check"
+ * runs it, it's skipped when there is no display.
+ */
+#define main gtktweeter_main
+#include "gtktweeter.c"
+#undef main
+
+static int failures = 0;
+
+#define CHECK(x) do { \
+  if (!(x)) { \
+    fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #x); \
+    failures++; \
+  } \
+} while (0)
+
+/* what a full reload does to the gaps of the window */
+static void
+reload_hook(TIMELINE_PAGE* page) {
+  gdk_threads_enter();
+  timeline_gaps_reset(page->window);
+  gdk_threads_leave();
+}
+
+/* a reload between the two locked sections drops the backfilled status */
+static void
+test_gap_deleted_while_unlocked() {
+  GtkWidget* textview = gtk_text_view_new();
+  GtkTextBuffer* buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(textview));
+  JSON_Value* value;
+  TIMELINE_PAGE page;
+  TIMELINE_GAP* gap;
+  GtkTextIter iter;
+  gint chars;
+
+  g_object_ref_sink(textview);
+  g_object_set_data(G_OBJECT(textview), "textview", textview);
+  g_object_set_data(G_OBJECT(textview), "buffer", buffer);
+  gtk_text_buffer_get_start_iter(buffer, &iter);
+  gap = timeline_gap_add(textview, &iter, SERVICE_HOME_STATUS_URL, NULL,
+          g_strdup("100"), g_strdup("200"));
+  gap->running = TRUE;
+  chars = gtk_text_buffer_get_char_count(buffer);
+
+  timeline_page_init(&page, textview);
+  page.gap = gap;
+  page.since_id = gap->since_id;
+  page.max_id = gap->max_id;
+  value = json_parse_string(
+          "{\"id_str\":\"150\",\"text\":\"hello\","
+          "\"created_at\":\"Sat Oct 17 00:00:00 +0000 2026\","
+          "\"user\":{\"id_str\":\"1\",\"name\":\"a\",\"screen_name\":\"a\"}}");
+  timeline_page_insert_hook = reload_hook;
+  timeline_page_insert(&page, json_value_get_object(value));
+  timeline_page_insert_hook = NULL;
+
+  CHECK(gtk_text_mark_get_deleted(gap->mark));
+  CHECK(gtk_text_buffer_get_char_count(buffer) == chars);
+
+  json_value_free(value);
+  timeline_gap_free(gap);
+  timeline_page_free(&page);
+  g_object_unref(textview);
+}
+
+int
+main(int argc, char* argv[]) {
+  g_thread_init(NULL);
+  gdk_threads_init();
+  /* 77 tells automake the test was skipped */
+  if (!gtk_init_check(&argc, &argv)) return 77;
+
+  test_gap_deleted_while_unlocked();
+  return failures ? 1 : 0;
+}
+
+/* vim:set et sw=4: */